@@ -0,0 +1,452 @@
+// Copyright 2024 Rik Essenius
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+// except in compliance with the License. You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and limitations under the License.
+
+// Benchmarks for the driver hot paths, running against the Wire mock. They measure the CPU cost of the driver
+// code itself (the bus is infinitely fast here), per call, per sample and per I2C transaction.
+// The bus counts the transactions the drivers do, so transactionsPerCall shows what they would cost on a real bus,
+// and a change in bus traffic shows up without anyone having to update the benchmarks.
+// The capture benchmarks measure the encoder and decoder throughput, the convert ones the unit conversion.
+
+#include <benchmark/benchmark.h>
+#include <cstring>
+#include <Wire.h>
+#include <Capture.h>
+#include <CicDecimator.h>
+#include <HmcSensor.h>
+#include <QmcSensor.h>
+#include <SensorBlock.h>
+#include <SensorFilter.h>
+#include <UnitConverter.h>
+#include <MagnetoSensorHmc.h>
+#include <MagnetoSensorNull.h>
+#include <MagnetoSensorQmc.h>
+#include <NoiseEstimator.h>
+#include <PulseDetector.h>
+
+namespace MagnetoSensorsBench {
+    using namespace MagnetoSensors;
+
+    // status byte that reports data ready on both sensors, and doesn't saturate
+    constexpr int ReadyByte = 0x01;
+
+    // the Wire mock, counting the transactions: every endTransmission and every requestFrom
+    class CountingWire final : public TwoWire {
+    public:
+        uint8_t endTransmission(const bool sendStop = true) override {
+            _transactions++;
+            return TwoWire::endTransmission(sendStop);
+        }
+
+        unsigned long long getTransactions() const { return _transactions; }
+
+        uint8_t requestFrom(const uint8_t address, const size_t size, const bool sendStop = true) override {
+            _transactions++;
+            return TwoWire::requestFrom(address, size, sendStop);
+        }
+
+        void resetTransactions() { _transactions = 0; }
+
+    private:
+        unsigned long long _transactions = 0;
+    };
+
+    CountingWire bus;
+
+    // The mock records all writes, so we need to clear it now and then
+    void resetBus() {
+        bus.begin();
+        bus.setFlatline(true, ReadyByte);
+    }
+
+    void maybeResetBus(unsigned int& calls) {
+        constexpr unsigned int ResetInterval = 8;
+        if (++calls % ResetInterval == 0) resetBus();
+    }
+
+    // call once the loop is done. Reports the transactions counted since prepare().
+    void setCounters(benchmark::State& state, const size_t samplesPerCall) {
+        state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * samplesPerCall));
+        const auto transactions = static_cast<double>(bus.getTransactions());
+        bus.resetTransactions();
+        if (transactions == 0 || state.iterations() == 0) return;
+        state.counters["transactionsPerCall"] = transactions / static_cast<double>(state.iterations());
+        state.counters["transactions"] = benchmark::Counter(transactions, benchmark::Counter::kIsRate);
+        state.counters["perTransaction"] = benchmark::Counter(transactions, benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+    }
+
+    template <class Sensor>
+    void prepare(Sensor& sensor) {
+        setRealTime(false);
+        resetBus();
+        sensor.begin();
+        resetBus();
+        bus.resetTransactions();
+    }
+
+    void hmcRead(benchmark::State& state) {
+        MagnetoSensorHmc sensor(&bus);
+        prepare(sensor);
+        SensorData sample{};
+        unsigned int calls = 0;
+        for (auto _ : state) {
+            benchmark::DoNotOptimize(sensor.read(sample));
+            maybeResetBus(calls);
+        }
+        // mode, data pointer, data
+        setCounters(state, 1);
+    }
+    BENCHMARK(hmcRead);
+
+    void hmcTemplateRead(benchmark::State& state) {
+        // compile-time configured, no virtual call
+        HmcSensor<> sensor(&bus);
+        prepare(sensor);
+        SensorData sample{};
+        unsigned int calls = 0;
+        for (auto _ : state) {
+            benchmark::DoNotOptimize(sensor.read(sample));
+            maybeResetBus(calls);
+        }
+        setCounters(state, 1);
+    }
+    BENCHMARK(hmcTemplateRead);
+
+    void hmcReadContinuous(benchmark::State& state) {
+        MagnetoSensorHmc sensor(&bus);
+        sensor.configureRate(HmcRate75, HmcContinuous);
+        prepare(sensor);
+        SensorData sample{};
+        unsigned int calls = 0;
+        for (auto _ : state) {
+            benchmark::DoNotOptimize(sensor.read(sample));
+            maybeResetBus(calls);
+        }
+        // data pointer, data and status
+        setCounters(state, 1);
+    }
+    BENCHMARK(hmcReadContinuous);
+
+    void hmcReadBatch(benchmark::State& state) {
+        MagnetoSensorHmc sensor(&bus);
+        prepare(sensor);
+        constexpr size_t BatchSize = 8;
+        SensorData samples[BatchSize];
+        unsigned long timestamps[BatchSize];
+        for (auto _ : state) {
+            benchmark::DoNotOptimize(sensor.readBatch(samples, BatchSize, timestamps));
+            resetBus();
+        }
+        // per sample: mode, status pointer, status, data pointer, data
+        setCounters(state, BatchSize);
+    }
+    BENCHMARK(hmcReadBatch);
+
+    void hmcSoftReset(benchmark::State& state) {
+        MagnetoSensorHmc sensor(&bus);
+        prepare(sensor);
+        unsigned int calls = 0;
+        for (auto _ : state) {
+            sensor.softReset();
+            maybeResetBus(calls);
+        }
+        // control A, B and mode in one write, then the test measurement (mode, data pointer, data)
+        setCounters(state, 0);
+    }
+    BENCHMARK(hmcSoftReset);
+
+    void hmcSwitchRange(benchmark::State& state) {
+        MagnetoSensorHmc sensor(&bus);
+        prepare(sensor);
+        unsigned int calls = 0;
+        for (auto _ : state) {
+            // alternate, so every call switches
+            if (!sensor.increaseRange()) sensor.decreaseRange();
+            maybeResetBus(calls);
+        }
+        // control B only, where a soft reset also does the mode and a read
+        setCounters(state, 0);
+    }
+    BENCHMARK(hmcSwitchRange);
+
+    void hmcBegin(benchmark::State& state) {
+        MagnetoSensorHmc sensor(&bus);
+        prepare(sensor);
+        unsigned int calls = 0;
+        for (auto _ : state) {
+            benchmark::DoNotOptimize(sensor.begin());
+            maybeResetBus(calls);
+        }
+        // begin() forgets the register shadow, but control A, control B and mode go in one transaction
+        setCounters(state, 0);
+    }
+    BENCHMARK(hmcBegin);
+
+    void hmcHandlePowerOn(benchmark::State& state) {
+        MagnetoSensorHmc sensor(&bus);
+        prepare(sensor);
+        unsigned int calls = 0;
+        for (auto _ : state) {
+            benchmark::DoNotOptimize(sensor.handlePowerOn());
+            maybeResetBus(calls);
+        }
+        // 4 test measurements (mode + read); switching the bias on and off goes in the same transaction as the mode
+        setCounters(state, 0);
+    }
+    BENCHMARK(hmcHandlePowerOn);
+
+    void qmcRead(benchmark::State& state) {
+        MagnetoSensorQmc sensor(&bus);
+        prepare(sensor);
+        SensorData sample{};
+        unsigned int calls = 0;
+        for (auto _ : state) {
+            benchmark::DoNotOptimize(sensor.read(sample));
+            maybeResetBus(calls);
+        }
+        // data pointer, data and status
+        setCounters(state, 1);
+    }
+    BENCHMARK(qmcRead);
+
+    void qmcTemplateRead(benchmark::State& state) {
+        // compile-time configured, no virtual call
+        QmcSensor<> sensor(&bus);
+        prepare(sensor);
+        SensorData sample{};
+        unsigned int calls = 0;
+        for (auto _ : state) {
+            benchmark::DoNotOptimize(sensor.read(sample));
+            maybeResetBus(calls);
+        }
+        setCounters(state, 1);
+    }
+    BENCHMARK(qmcTemplateRead);
+
+    void qmcReadBatch(benchmark::State& state) {
+        MagnetoSensorQmc sensor(&bus);
+        prepare(sensor);
+        constexpr size_t BatchSize = 8;
+        SensorData samples[BatchSize];
+        unsigned long timestamps[BatchSize];
+        for (auto _ : state) {
+            benchmark::DoNotOptimize(sensor.readBatch(samples, BatchSize, timestamps));
+            resetBus();
+        }
+        setCounters(state, BatchSize);
+    }
+    BENCHMARK(qmcReadBatch);
+
+    void qmcSoftReset(benchmark::State& state) {
+        MagnetoSensorQmc sensor(&bus);
+        prepare(sensor);
+        unsigned int calls = 0;
+        for (auto _ : state) {
+            sensor.softReset();
+            maybeResetBus(calls);
+        }
+        // control 2 (reset), set/reset, control 2 (roll-over), control 1. The reset clears the registers, so the shadow
+        // can't skip anything.
+        setCounters(state, 0);
+    }
+    BENCHMARK(qmcSoftReset);
+
+    void qmcBegin(benchmark::State& state) {
+        MagnetoSensorQmc sensor(&bus);
+        prepare(sensor);
+        unsigned int calls = 0;
+        for (auto _ : state) {
+            benchmark::DoNotOptimize(sensor.begin());
+            maybeResetBus(calls);
+        }
+        setCounters(state, 0);
+    }
+    BENCHMARK(qmcBegin);
+
+    void nullRead(benchmark::State& state) {
+        MagnetoSensorNull sensor;
+        MagnetoSensor* base = &sensor;
+        SensorData sample{};
+        for (auto _ : state) {
+            // through the base class, so we include the virtual call
+            benchmark::DoNotOptimize(base->read(sample));
+        }
+        setCounters(state, 1);
+    }
+    BENCHMARK(nullRead);
+
+    // a slowly changing signal with a bit of noise, like a meter in use
+    SensorData captureSample(const unsigned int index) {
+        const auto noise = static_cast<short>(index * 7 % 5);
+        const auto ramp = static_cast<short>(index % 400);
+        return { static_cast<short>(ramp + noise), static_cast<short>(200 - ramp - noise), static_cast<short>(-300 + noise) };
+    }
+
+    void captureWrite(benchmark::State& state) {
+        CaptureWriter writer;
+        unsigned int index = 0;
+        for (auto _ : state) {
+            benchmark::DoNotOptimize(writer.add(captureSample(index++)));
+        }
+        setCounters(state, 1);
+        state.counters["bytesPerSample"] = static_cast<double>(writer.getBytes()) / static_cast<double>(writer.getSamples());
+    }
+    BENCHMARK(captureWrite);
+
+    void captureRead(benchmark::State& state) {
+        constexpr unsigned int Blocks = 64;
+        static byte capture[Blocks * CaptureWriter::MaxBlockSize];
+        size_t size = 0;
+        CaptureWriter writer;
+        for (unsigned int i = 0; i < Blocks * CaptureWriter::SamplesPerBlock; i++) {
+            if (writer.add(captureSample(i))) {
+                memcpy(capture + size, writer.getBlock(), writer.getBlockSize());
+                size += writer.getBlockSize();
+            }
+        }
+        CaptureReader reader(capture, size);
+        SensorData samples[CaptureWriter::SamplesPerBlock];
+        for (auto _ : state) {
+            if (reader.read(samples, CaptureWriter::SamplesPerBlock) == 0) {
+                reader.rewind();
+            }
+            benchmark::DoNotOptimize(samples);
+        }
+        setCounters(state, CaptureWriter::SamplesPerBlock);
+    }
+    BENCHMARK(captureRead);
+
+    constexpr size_t ConvertBatch = 128;
+
+    void convertDivide(benchmark::State& state) {
+        // what consumers did before: divide by the gain for every value
+        MagnetoSensorQmc sensor(&bus);
+        SensorData samples[ConvertBatch];
+        for (unsigned int i = 0; i < ConvertBatch; i++) samples[i] = captureSample(i);
+        float out[3 * ConvertBatch];
+        for (auto _ : state) {
+            for (size_t i = 0; i < ConvertBatch; i++) {
+                out[3 * i] = static_cast<float>(samples[i].x * 100.0 / sensor.getGain());
+                out[3 * i + 1] = static_cast<float>(samples[i].y * 100.0 / sensor.getGain());
+                out[3 * i + 2] = static_cast<float>(samples[i].z * 100.0 / sensor.getGain());
+            }
+            benchmark::DoNotOptimize(out);
+        }
+        setCounters(state, ConvertBatch);
+    }
+    BENCHMARK(convertDivide);
+
+    void convertFloat(benchmark::State& state) {
+        const auto& converter = UnitConverter::get(QmcRange8G);
+        SensorData samples[ConvertBatch];
+        for (unsigned int i = 0; i < ConvertBatch; i++) samples[i] = captureSample(i);
+        float out[3 * ConvertBatch];
+        for (auto _ : state) {
+            converter.toMicroTesla(samples, out, ConvertBatch);
+            benchmark::DoNotOptimize(out);
+        }
+        setCounters(state, ConvertBatch);
+    }
+    BENCHMARK(convertFloat);
+
+    void convertFixed(benchmark::State& state) {
+        const auto& converter = UnitConverter::get(QmcRange8G);
+        SensorData samples[ConvertBatch];
+        for (unsigned int i = 0; i < ConvertBatch; i++) samples[i] = captureSample(i);
+        int32_t out[3 * ConvertBatch];
+        for (auto _ : state) {
+            converter.toNanoTesla(samples, out, ConvertBatch);
+            benchmark::DoNotOptimize(out);
+        }
+        setCounters(state, ConvertBatch);
+    }
+    BENCHMARK(convertFixed);
+
+    void blockSummarize(benchmark::State& state) {
+        SensorBlock<ConvertBatch> block;
+        for (unsigned int i = 0; i < ConvertBatch; i++) block.push(captureSample(i));
+        for (auto _ : state) {
+            auto summary = block.summarize();
+            benchmark::DoNotOptimize(summary);
+        }
+        setCounters(state, ConvertBatch);
+    }
+    BENCHMARK(blockSummarize);
+
+    void noiseEstimate(benchmark::State& state) {
+        NoiseEstimator estimator;
+        SensorData samples[ConvertBatch];
+        for (unsigned int i = 0; i < ConvertBatch; i++) samples[i] = captureSample(i);
+        for (auto _ : state) {
+            for (const auto& sample : samples) estimator.add(sample);
+        }
+        benchmark::DoNotOptimize(estimator.getNoiseRange());
+        setCounters(state, ConvertBatch);
+    }
+    BENCHMARK(noiseEstimate);
+
+    void lowPass(benchmark::State& state) {
+        LowPassFilter filter;
+        filter.configure(5, MagnetoSensorQmc::getSampleRate(QmcRate100Hz));
+        SensorData input[ConvertBatch];
+        for (unsigned int i = 0; i < ConvertBatch; i++) input[i] = captureSample(i);
+        SensorData samples[ConvertBatch];
+        for (auto _ : state) {
+            std::memcpy(samples, input, sizeof samples);
+            filter.apply(samples, ConvertBatch);
+            benchmark::DoNotOptimize(samples);
+        }
+        setCounters(state, ConvertBatch);
+    }
+    BENCHMARK(lowPass);
+
+    void movingAverage(benchmark::State& state) {
+        MovingAverage<32> average;
+        SensorData input[ConvertBatch];
+        for (unsigned int i = 0; i < ConvertBatch; i++) input[i] = captureSample(i);
+        SensorData samples[ConvertBatch];
+        for (auto _ : state) {
+            std::memcpy(samples, input, sizeof samples);
+            average.apply(samples, ConvertBatch);
+            benchmark::DoNotOptimize(samples);
+        }
+        setCounters(state, ConvertBatch);
+    }
+    BENCHMARK(movingAverage);
+
+    void cicDecimate(benchmark::State& state) {
+        CicDecimator decimator;
+        decimator.configure(4);
+        SensorData input[ConvertBatch];
+        for (unsigned int i = 0; i < ConvertBatch; i++) input[i] = captureSample(i);
+        SensorData output[ConvertBatch];
+        for (auto _ : state) {
+            benchmark::DoNotOptimize(decimator.apply(input, ConvertBatch, output));
+        }
+        setCounters(state, ConvertBatch);
+    }
+    BENCHMARK(cicDecimate);
+
+    void pulseDetect(benchmark::State& state) {
+        const MagnetoSensorNull sensor;
+        PulseDetector detector(&sensor);
+        detector.begin();
+        SensorData samples[ConvertBatch];
+        for (unsigned int i = 0; i < ConvertBatch; i++) samples[i] = captureSample(i);
+        PulseEvent event{};
+        for (auto _ : state) {
+            for (size_t i = 0; i < ConvertBatch; i++) {
+                benchmark::DoNotOptimize(detector.update(samples[i], i, event));
+            }
+        }
+        setCounters(state, ConvertBatch);
+    }
+    BENCHMARK(pulseDetect);
+}
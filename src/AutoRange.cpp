@@ -0,0 +1,111 @@
+// Copyright 2024 Rik Essenius
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+// except in compliance with the License. You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and limitations under the License.
+
+#include "AutoRange.h"
+#include <cstdlib>
+
+namespace MagnetoSensors {
+    AutoRange::AutoRange(MagnetoSensor* sensor) : _sensor(sensor) {}
+
+    void AutoRange::begin() {
+        _holdSamples = _configuredHold;
+        _lastWasDecrease = false;
+        _increases = 0;
+        _decreases = 0;
+        startRange();
+        _settle = 0;
+    }
+
+    void AutoRange::configureThresholds(const byte upperPercent, const byte lowerPercent) {
+        _upperPercent = upperPercent;
+        _lowerPercent = lowerPercent;
+    }
+
+    void AutoRange::configureTiming(const unsigned int holdSamples, const unsigned int settleSamples) {
+        _configuredHold = holdSamples;
+        _holdSamples = holdSamples;
+        _settleSamples = settleSamples;
+    }
+
+    bool AutoRange::decrease() {
+        if (!_sensor->decreaseRange()) return false;
+        _decreases++;
+        _lastWasDecrease = true;
+        startRange();
+        return true;
+    }
+
+    unsigned long AutoRange::getDecreases() const {
+        return _decreases;
+    }
+
+    unsigned int AutoRange::getHoldSamples() const {
+        return _holdSamples;
+    }
+
+    unsigned long AutoRange::getIncreases() const {
+        return _increases;
+    }
+
+    int AutoRange::getPeak(const SensorData& sample) {
+        // saturated axes are SHRT_MIN, so they end up as the highest peak
+        int peak = std::abs(sample.x);
+        if (std::abs(sample.y) > peak) peak = std::abs(sample.y);
+        if (std::abs(sample.z) > peak) peak = std::abs(sample.z);
+        return peak;
+    }
+
+    bool AutoRange::increase() {
+        if (!_sensor->increaseRange()) return false;
+        _increases++;
+        // going back up shortly after going down means the field sits near the boundary
+        if (_lastWasDecrease && _samplesInRange < _holdSamples && _holdSamples < _configuredHold * MaxHoldFactor) {
+            _holdSamples *= 2;
+        }
+        _lastWasDecrease = false;
+        startRange();
+        return true;
+    }
+
+    void AutoRange::startRange() {
+        const int limit = _sensor->getCountLimit();
+        _upperLimit = limit * _upperPercent / 100;
+        const double lowerGain = _sensor->getLowerRangeGain();
+        // the threshold in the lower range, converted to counts in the current range
+        _lowerLimit = lowerGain > 0.0
+            ? static_cast<int>(limit * _lowerPercent / 100 * _sensor->getGain() / lowerGain)
+            : -1;
+        _settle = _settleSamples;
+        _quiet = 0;
+        _samplesInRange = 0;
+    }
+
+    bool AutoRange::update(const SensorData& sample) {
+        _samplesInRange++;
+        if (_settle > 0) {
+            _settle--;
+            return false;
+        }
+        if (_sensor->hasOldGain()) return false;
+        const int peak = getPeak(sample);
+        if (peak > _upperLimit) {
+            _quiet = 0;
+            return increase();
+        }
+        if (peak > _lowerLimit) {
+            _quiet = 0;
+            return false;
+        }
+        _quiet++;
+        if (_quiet < _holdSamples) return false;
+        return decrease();
+    }
+}
@@ -0,0 +1,75 @@
+// Copyright 2024 Rik Essenius
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+// except in compliance with the License. You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and limitations under the License.
+
+// Keeps a sensor in the most sensitive range that the field allows. Feed it every sample.
+//
+// It switches to a less sensitive range as soon as a sample gets close to the count limit, so usually before
+// anything saturates. It switches back when the samples would have fitted comfortably in the more sensitive range
+// for a while. The gap between the two thresholds prevents flapping around a single value, and the hold time
+// limits how often the range can go down. If the range needs to go up again soon after going down, the hold time
+// doubles (up to MaxHoldFactor times the configured value), so a field that keeps crossing the boundary
+// settles in the less sensitive range.
+
+#ifndef HEADER_AUTO_RANGE
+#define HEADER_AUTO_RANGE
+
+#include "MagnetoSensor.h"
+
+namespace MagnetoSensors {
+    class AutoRange {
+    public:
+        static constexpr unsigned int MaxHoldFactor = 16;
+
+        explicit AutoRange(MagnetoSensor* sensor);
+
+        // Switch up when an axis exceeds upperPercent of the count limit. Switch down when all axes would stay
+        // below lowerPercent of the limit in the more sensitive range. Keep lowerPercent well below upperPercent.
+        void configureThresholds(byte upperPercent, byte lowerPercent);
+
+        // how many samples in a row need to have headroom before switching down, and how many samples
+        // to ignore after a switch. Samples for which the sensor reports hasOldGain() are always ignored.
+        void configureTiming(unsigned int holdSamples, unsigned int settleSamples);
+
+        // start with the current range of the sensor. Call after the sensor's begin()
+        void begin();
+
+        unsigned long getDecreases() const;
+        unsigned int getHoldSamples() const;
+        unsigned long getIncreases() const;
+
+        // returns true if the range changed, i.e. the next samples have a different gain
+        bool update(const SensorData& sample);
+
+    private:
+        static int getPeak(const SensorData& sample);
+        bool decrease();
+        bool increase();
+        void startRange();
+
+        MagnetoSensor* _sensor;
+        byte _upperPercent = 80;
+        byte _lowerPercent = 40;
+        unsigned int _configuredHold = 100;
+        unsigned int _settleSamples = 2;
+
+        // thresholds in counts of the current range. _lowerLimit is -1 if there is no more sensitive range.
+        int _upperLimit = 0;
+        int _lowerLimit = -1;
+        unsigned int _holdSamples = 100;
+        unsigned int _settle = 0;
+        unsigned int _quiet = 0;
+        unsigned long _samplesInRange = 0;
+        bool _lastWasDecrease = false;
+        unsigned long _increases = 0;
+        unsigned long _decreases = 0;
+    };
+}
+#endif
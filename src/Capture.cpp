@@ -0,0 +1,240 @@
+// Copyright 2024 Rik Essenius
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+// except in compliance with the License. You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and limitations under the License.
+
+#include "Capture.h"
+#include <cstring>
+
+namespace MagnetoSensors {
+    namespace {
+        constexpr byte BlockMarker = 0xB5;
+        constexpr byte VarintMore = 0x80;
+        constexpr byte VarintBits = 7;
+        // more than that doesn't fit in 32 bits
+        constexpr byte MaxVarintSize = 5;
+
+        // small values of either sign become small unsigned ones: 0, -1, 1, -2, ... => 0, 1, 2, 3, ...
+        uint32_t zigzag(const int32_t value) {
+            return (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31);
+        }
+
+        int32_t unzigzag(const uint32_t value) {
+            return static_cast<int32_t>((value >> 1) ^ (~(value & 1) + 1));
+        }
+
+        size_t encodeVarint(uint32_t value, byte* target) {
+            size_t size = 0;
+            while (value >= VarintMore) {
+                target[size++] = static_cast<byte>(value | VarintMore);
+                value >>= VarintBits;
+            }
+            target[size++] = static_cast<byte>(value);
+            return size;
+        }
+    }
+
+    // CaptureWriter
+
+    // C++11 needs these definitions when the constants are bound to references
+    constexpr size_t CaptureWriter::SamplesPerBlock;
+    constexpr size_t CaptureWriter::MaxBlockSize;
+
+    bool CaptureWriter::add(const SensorData& sample, const unsigned long timestamp) {
+        if (_blockSamples == 0) {
+            // this overwrites the block we completed before
+            _blockSize = 0;
+            _payloadEnd = MaxHeaderSize;
+            _blockTimestamp = timestamp;
+            putVarint(zigzag(sample.x));
+            putVarint(zigzag(sample.y));
+            putVarint(zigzag(sample.z));
+        }
+        else {
+            const int32_t deltaX = sample.x - _previous.x;
+            const int32_t deltaY = sample.y - _previous.y;
+            const int32_t deltaZ = sample.z - _previous.z;
+            if (deltaX == 0 && deltaY == 0 && deltaZ == 0) {
+                _run++;
+            }
+            else {
+                putRun();
+                putVarint(zigzag(deltaX) << 1);
+                putVarint(zigzag(deltaY));
+                putVarint(zigzag(deltaZ));
+            }
+        }
+        _previous = sample;
+        _blockSamples++;
+        if (_blockSamples < SamplesPerBlock) return false;
+        finishBlock();
+        return true;
+    }
+
+    void CaptureWriter::finishBlock() {
+        putRun();
+        byte header[MaxHeaderSize];
+        size_t headerSize = 0;
+        header[headerSize++] = BlockMarker;
+        headerSize += encodeVarint(static_cast<uint32_t>(_blockSamples), header + headerSize);
+        headerSize += encodeVarint(static_cast<uint32_t>(_blockTimestamp), header + headerSize);
+        const size_t payloadSize = _payloadEnd - MaxHeaderSize;
+        headerSize += encodeVarint(static_cast<uint32_t>(payloadSize), header + headerSize);
+
+        // put the header right in front of the payload, so the block is contiguous
+        _blockStart = MaxHeaderSize - headerSize;
+        memcpy(_buffer + _blockStart, header, headerSize);
+        _blockSize = headerSize + payloadSize;
+        _bytes += _blockSize;
+        _samples += _blockSamples;
+        _blockSamples = 0;
+    }
+
+    bool CaptureWriter::flush() {
+        if (_blockSamples == 0) return false;
+        finishBlock();
+        return true;
+    }
+
+    void CaptureWriter::putRun() {
+        if (_run == 0) return;
+        putVarint(_run << 1 | 1);
+        _run = 0;
+    }
+
+    void CaptureWriter::putVarint(const uint32_t value) {
+        _payloadEnd += encodeVarint(value, _buffer + _payloadEnd);
+    }
+
+    // CaptureReader
+
+    CaptureReader::CaptureReader(const byte* data, const size_t size) : _data(data), _size(size) {}
+
+    unsigned long CaptureReader::countSamples() const {
+        unsigned long count = 0;
+        size_t offset = 0;
+        BlockHeader header {};
+        while (offset < _size && parseHeader(offset, header)) {
+            count += header.count;
+            offset = header.payloadEnd;
+        }
+        return count;
+    }
+
+    bool CaptureReader::getVarint(size_t& offset, const size_t end, uint32_t& value) const {
+        value = 0;
+        for (byte i = 0; i < MaxVarintSize && offset < end; i++) {
+            const byte current = _data[offset++];
+            value |= static_cast<uint32_t>(current & ~VarintMore) << (i * VarintBits);
+            if ((current & VarintMore) == 0) return true;
+        }
+        return false;
+    }
+
+    bool CaptureReader::openBlock() {
+        if (_nextBlock >= _size) return false;
+        BlockHeader header {};
+        if (!parseHeader(_nextBlock, header)) {
+            _error = true;
+            _nextBlock = _size;
+            return false;
+        }
+        _offset = header.payloadStart;
+        _payloadEnd = header.payloadEnd;
+        _nextBlock = header.payloadEnd;
+        _blockRemaining = header.count;
+        _blockTimestamp = header.timestamp;
+        _run = 0;
+        _atKeyframe = true;
+        return true;
+    }
+
+    bool CaptureReader::parseHeader(size_t offset, BlockHeader& header) const {
+        if (_data == nullptr || offset >= _size || _data[offset] != BlockMarker) return false;
+        offset++;
+        uint32_t payloadSize;
+        if (!getVarint(offset, _size, header.count) ||
+            !getVarint(offset, _size, header.timestamp) ||
+            !getVarint(offset, _size, payloadSize)) return false;
+        if (header.count == 0 || header.count > CaptureWriter::SamplesPerBlock || payloadSize > _size - offset) return false;
+        header.payloadStart = offset;
+        header.payloadEnd = offset + payloadSize;
+        return true;
+    }
+
+    size_t CaptureReader::read(SensorData* samples, const size_t count) {
+        size_t produced = 0;
+        while (produced < count) {
+            if (_blockRemaining == 0 && !openBlock()) break;
+            if (_run > 0) {
+                _run--;
+            }
+            else {
+                uint32_t first, second, third;
+                if (!getVarint(_offset, _payloadEnd, first)) break;
+                if (!_atKeyframe && (first & 1) != 0) {
+                    _run = first >> 1;
+                    if (_run == 0 || _run > _blockRemaining) break;
+                    continue;
+                }
+                if (!getVarint(_offset, _payloadEnd, second) || !getVarint(_offset, _payloadEnd, third)) break;
+                if (_atKeyframe) {
+                    _previous.x = static_cast<short>(unzigzag(first));
+                    _previous.y = static_cast<short>(unzigzag(second));
+                    _previous.z = static_cast<short>(unzigzag(third));
+                    _atKeyframe = false;
+                }
+                else {
+                    _previous.x = static_cast<short>(_previous.x + unzigzag(first >> 1));
+                    _previous.y = static_cast<short>(_previous.y + unzigzag(second));
+                    _previous.z = static_cast<short>(_previous.z + unzigzag(third));
+                }
+            }
+            samples[produced++] = _previous;
+            _blockRemaining--;
+            _position++;
+        }
+        if (produced < count && _blockRemaining > 0) {
+            // we stopped in the middle of a block, so the data is corrupt
+            _error = true;
+            _blockRemaining = 0;
+            _nextBlock = _size;
+        }
+        return produced;
+    }
+
+    void CaptureReader::rewind() {
+        _nextBlock = 0;
+        _blockRemaining = 0;
+        _run = 0;
+        _position = 0;
+        _error = false;
+    }
+
+    bool CaptureReader::seek(const unsigned long index) {
+        rewind();
+        BlockHeader header {};
+        while (_nextBlock < _size && parseHeader(_nextBlock, header)) {
+            if (index < _position + header.count) {
+                openBlock();
+                // decode up to the sample we need
+                constexpr unsigned long SkipSize = 8;
+                SensorData skipped[SkipSize];
+                while (_position < index) {
+                    const unsigned long toSkip = index - _position;
+                    if (read(skipped, toSkip < SkipSize ? toSkip : SkipSize) == 0) return false;
+                }
+                return true;
+            }
+            _position += header.count;
+            _nextBlock = header.payloadEnd;
+        }
+        return false;
+    }
+}
@@ -0,0 +1,122 @@
+// Copyright 2024 Rik Essenius
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+// except in compliance with the License. You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and limitations under the License.
+
+// Compact capture format for streams of samples. Consecutive samples hardly differ, so we store per axis
+// differences as zig-zag varints (small differences take one byte), and a stretch of identical samples as one run.
+//
+// The stream is a sequence of blocks of at most SamplesPerBlock samples. Each block starts with a header
+// (marker, sample count, timestamp of the first sample, payload length) and a keyframe with the absolute values,
+// so a reader can skip to any block without decoding the ones before it.
+//
+// Payload entries after the keyframe: a varint v. If v is odd, v >> 1 samples repeat the previous one.
+// Otherwise v >> 1 is the zig-zag X difference, followed by the zig-zag Y and Z differences.
+
+#ifndef HEADER_CAPTURE
+#define HEADER_CAPTURE
+
+#include "SensorData.h"
+
+namespace MagnetoSensors {
+
+    // Builds the capture block by block in a fixed buffer, so it doesn't allocate.
+    // Write each completed block to storage before adding the next sample.
+
+    class CaptureWriter {
+    public:
+        static constexpr size_t SamplesPerBlock = 128;
+        // marker, count (2), timestamp (5), payload length (2)
+        static constexpr size_t MaxHeaderSize = 10;
+        // three differences that take at most 3 bytes each
+        static constexpr size_t MaxEntrySize = 9;
+        static constexpr size_t MaxBlockSize = MaxHeaderSize + SamplesPerBlock * MaxEntrySize;
+
+        // Add a sample. Returns true if that completed a block, which is then available until the next add().
+        // Only the timestamp of the first sample in a block is stored.
+        bool add(const SensorData& sample, unsigned long timestamp = 0);
+
+        // complete a partial block, e.g. before shutting down. Returns false if there was nothing to complete.
+        bool flush();
+
+        const byte* getBlock() const { return _buffer + _blockStart; }
+        size_t getBlockSize() const { return _blockSize; }
+
+        // totals over the completed blocks
+        unsigned long getBytes() const { return _bytes; }
+        unsigned long getSamples() const { return _samples; }
+
+    private:
+        void finishBlock();
+        void putVarint(uint32_t value);
+        void putRun();
+
+        byte _buffer[MaxBlockSize] {};
+        size_t _payloadEnd = MaxHeaderSize;
+        size_t _blockStart = 0;
+        size_t _blockSize = 0;
+        size_t _blockSamples = 0;
+        unsigned long _blockTimestamp = 0;
+        uint32_t _run = 0;
+        SensorData _previous {};
+        unsigned long _bytes = 0;
+        unsigned long _samples = 0;
+    };
+
+    // Decodes a capture that is in memory (e.g. memory-mapped), straight into the caller's buffer.
+
+    class CaptureReader {
+    public:
+        CaptureReader() = default;
+        CaptureReader(const byte* data, size_t size);
+
+        // the total number of samples, from the block headers
+        unsigned long countSamples() const;
+
+        unsigned long getBlockTimestamp() const { return _blockTimestamp; }
+        unsigned long getPosition() const { return _position; }
+
+        // true if decoding stopped on corrupt data
+        bool hasError() const { return _error; }
+
+        // decode up to count samples. Returns the number decoded, which is less than count at the end of the capture.
+        size_t read(SensorData* samples, size_t count);
+
+        void rewind();
+
+        // continue at the given sample. Returns false if that's beyond the end.
+        bool seek(unsigned long index);
+
+    private:
+        struct BlockHeader {
+            uint32_t count;
+            uint32_t timestamp;
+            size_t payloadStart;
+            size_t payloadEnd;
+        };
+
+        bool getVarint(size_t& offset, size_t end, uint32_t& value) const;
+        bool openBlock();
+        bool parseHeader(size_t offset, BlockHeader& header) const;
+
+        const byte* _data = nullptr;
+        size_t _size = 0;
+        size_t _offset = 0;
+        size_t _payloadEnd = 0;
+        size_t _nextBlock = 0;
+        uint32_t _blockRemaining = 0;
+        uint32_t _run = 0;
+        bool _atKeyframe = false;
+        bool _error = false;
+        unsigned long _blockTimestamp = 0;
+        unsigned long _position = 0;
+        SensorData _previous {};
+    };
+}
+#endif
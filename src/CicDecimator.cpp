@@ -0,0 +1,131 @@
+// Copyright 2024 Rik Essenius
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+// except in compliance with the License. You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and limitations under the License.
+
+#include "CicDecimator.h"
+
+namespace MagnetoSensors {
+    namespace {
+        // SHRT_MIN means saturated, so the output never gets that value otherwise
+        short clampToShort(const int64_t value) {
+            if (value > SHRT_MAX) return SHRT_MAX;
+            if (value < -SHRT_MAX) return -SHRT_MAX;
+            return static_cast<short>(value);
+        }
+    }
+
+    constexpr byte CicDecimator::MaxOrder;
+    constexpr uint32_t CicDecimator::MaxGain;
+    constexpr int CicDecimator::AxisCount;
+    constexpr int CicDecimator::CompensationBits;
+
+    bool CicDecimator::add(const SensorData& input, SensorData& output) {
+        if (!_isPrimed) prime(input);
+        const short values[] = { input.x, input.y, input.z };
+        short results[AxisCount];
+        if (!push(values, results)) return false;
+        output = { results[0], results[1], results[2] };
+        return true;
+    }
+
+    size_t CicDecimator::apply(const SensorData* input, const size_t count, SensorData* output) {
+        size_t outputCount = 0;
+        for (size_t i = 0; i < count; i++) {
+            SensorData result{};
+            if (add(input[i], result)) output[outputCount++] = result;
+        }
+        return outputCount;
+    }
+
+    short CicDecimator::compensate(const short value, AxisState& state) const {
+        constexpr int32_t One = 1 << CompensationBits;
+        const int32_t sum = (One + 2 * _compensation) * state.history[0] - _compensation * (value + state.history[1]);
+        state.history[1] = state.history[0];
+        state.history[0] = value;
+        return clampToShort((sum + One / 2) >> CompensationBits);
+    }
+
+    bool CicDecimator::configure(const unsigned int ratio, const byte order, const bool compensate) {
+        if (ratio == 0 || order == 0 || order > MaxOrder) return false;
+        uint32_t gain = 1;
+        for (byte i = 0; i < order; i++) {
+            if (static_cast<uint64_t>(gain) * ratio > MaxGain) return false;
+            gain *= ratio;
+        }
+        _ratio = ratio;
+        _order = order;
+        _isCompensated = compensate;
+        _reciprocal = ((1LL << 32) + gain / 2) / gain;
+        // the droop of a CIC filter at low frequencies is about order * (pi f)^2 / 6 (f relative to the output rate),
+        // and the compensation filter adds 4 a (pi f)^2. So a = order / 24.
+        _compensation = ((order << CompensationBits) + 12) / 24;
+        reset();
+        return true;
+    }
+
+    unsigned int CicDecimator::getRatio() const {
+        return _ratio;
+    }
+
+    void CicDecimator::prime(const SensorData& input) {
+        // run the filter on the first sample until all stages hold it, as if the input had always been there
+        _isPrimed = true;
+        const short values[] = {
+            input.x == SHRT_MIN ? static_cast<short>(0) : input.x,
+            input.y == SHRT_MIN ? static_cast<short>(0) : input.y,
+            input.z == SHRT_MIN ? static_cast<short>(0) : input.z
+        };
+        short results[AxisCount];
+        for (unsigned int i = 0; i < (_order + 1u) * _ratio; i++) push(values, results);
+        for (int axis = 0; axis < AxisCount; axis++) {
+            _state[axis].history[0] = values[axis];
+            _state[axis].history[1] = values[axis];
+        }
+    }
+
+    bool CicDecimator::push(const short* values, short* results) {
+        const unsigned int saturationSpan = (_order + (_isCompensated ? 2u : 0u)) * _ratio;
+        const bool isOutput = ++_phase == _ratio;
+        if (isOutput) _phase = 0;
+        for (int axis = 0; axis < AxisCount; axis++) {
+            AxisState& state = _state[axis];
+            // a saturated value has no meaning, so keep integrating the last good one and mark the outputs it touches
+            if (values[axis] == SHRT_MIN) {
+                state.saturatedInputs = saturationSpan;
+            } else {
+                state.held = values[axis];
+                if (state.saturatedInputs > 0) state.saturatedInputs--;
+            }
+            // unsigned, since the integrators are allowed to wrap around
+            auto value = static_cast<uint32_t>(static_cast<int32_t>(state.held));
+            for (byte stage = 0; stage < _order; stage++) {
+                state.integrator[stage] += value;
+                value = state.integrator[stage];
+            }
+            if (!isOutput) continue;
+            for (byte stage = 0; stage < _order; stage++) {
+                const uint32_t previous = state.comb[stage];
+                state.comb[stage] = value;
+                value -= previous;
+            }
+            const int64_t sum = static_cast<int32_t>(value);
+            short result = clampToShort((sum * _reciprocal + (1LL << 31)) >> 32);
+            if (_isCompensated) result = compensate(result, state);
+            results[axis] = state.saturatedInputs > 0 ? static_cast<short>(SHRT_MIN) : result;
+        }
+        return isOutput;
+    }
+
+    void CicDecimator::reset() {
+        for (auto& state : _state) state = AxisState();
+        _phase = 0;
+        _isPrimed = false;
+    }
+}
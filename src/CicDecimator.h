@@ -0,0 +1,75 @@
+// Copyright 2024 Rik Essenius
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+// except in compliance with the License. You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and limitations under the License.
+
+// Reduces the sample rate by an integer ratio, with a cascaded integrator-comb (CIC) filter in integer arithmetic.
+// That allows running the sensor fast with little hardware oversampling (quick conversions), and averaging in
+// software instead. E.g. a QMC at QmcRate200Hz with QmcSampling64 and a ratio of 4 gives 50 Hz output.
+//
+// A CIC filter of order N averages N times over the last ratio samples, so it costs a few additions per sample,
+// whatever the ratio. It attenuates the band edge a bit (droop); the optional compensation stage, a 3 tap FIR
+// at the output rate, flattens the pass band. That costs one output sample of delay.
+//
+// The integrators wrap around, which is fine for a CIC filter as long as the gain (ratio ^ order) fits 16 bits,
+// so the output fits 32 bits. A saturated axis (SHRT_MIN) makes the outputs that depend on it saturated too.
+
+#ifndef HEADER_CIC_DECIMATOR
+#define HEADER_CIC_DECIMATOR
+
+#include "SensorData.h"
+
+namespace MagnetoSensors {
+    class CicDecimator {
+    public:
+        static constexpr byte MaxOrder = 4;
+        static constexpr uint32_t MaxGain = 65536;
+
+        // returns false (and keeps the old configuration) if ratio ^ order is larger than MaxGain
+        bool configure(unsigned int ratio, byte order = 3, bool compensate = true);
+
+        // returns true if there is a new output sample, i.e. every ratio-th input
+        bool add(const SensorData& input, SensorData& output);
+
+        // decimate a block of inputs. Returns the number of outputs written (at most count / ratio + 1).
+        // Can be called in place (output == input), since outputs never overtake inputs.
+        size_t apply(const SensorData* input, size_t count, SensorData* output);
+
+        unsigned int getRatio() const;
+        void reset();
+
+    private:
+        static constexpr int AxisCount = 3;
+        static constexpr int CompensationBits = 8;
+
+        struct AxisState {
+            uint32_t integrator[MaxOrder];
+            uint32_t comb[MaxOrder];
+            short history[2];
+            short held;
+            unsigned int saturatedInputs;
+        };
+
+        short compensate(short value, AxisState& state) const;
+        void prime(const SensorData& input);
+        bool push(const short* values, short* results);
+
+        unsigned int _ratio = 1;
+        byte _order = 1;
+        bool _isCompensated = false;
+        // output = sum * _reciprocal >> 32, to divide by the gain
+        int64_t _reciprocal = 1LL << 32;
+        // the compensation filter is -a, 1 + 2a, -a with a in CompensationBits fraction bits
+        int32_t _compensation = 0;
+        unsigned int _phase = 0;
+        bool _isPrimed = false;
+        AxisState _state[AxisCount] {};
+    };
+}
+#endif
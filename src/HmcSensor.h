@@ -0,0 +1,159 @@
+// Copyright 2024 Rik Essenius
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+// except in compliance with the License. You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and limitations under the License.
+
+// HMC5883L sensor with the configuration fixed at compile time, for when it never changes after flashing.
+// The register values, gain and noise range are constants, and read() is not virtual so it can be inlined.
+// The tables and the bus protocol are the ones MagnetoSensorHmc uses. There are no statistics, and no register shadow
+// as the configuration is only written by softReset().
+// Use MagnetoSensorAdapter if you need it as a MagnetoSensor. The self test stays with MagnetoSensorHmc.
+//
+// Example: HmcSensor<HmcRange4_7, HmcRate75, HmcSampling8, HmcContinuous> sensor(&Wire);
+
+#ifndef HEADER_HMC_SENSOR
+#define HEADER_HMC_SENSOR
+
+#include "MagnetoSensorHmc.h"
+
+namespace MagnetoSensors {
+    // (the HmcMode register name hides the HmcMode type, hence the elaborated type specifier)
+    template <HmcRange Range = HmcRange4_7, HmcRate Rate = HmcRate75, HmcOverSampling OverSampling = HmcSampling8,
+              enum HmcMode Mode = HmcSingle>
+    class HmcSensor {
+    public:
+        static constexpr byte DefaultAddress = 0x1E;
+        static constexpr byte ControlA = static_cast<byte>(OverSampling | Rate | HmcNone);
+        static constexpr byte ControlB = static_cast<byte>(Range);
+        static constexpr byte ModeValue = static_cast<byte>(Mode);
+        static constexpr double Gain = MagnetoSensorHmc::getGain(Range);
+        static constexpr int NoiseRange = MagnetoSensorHmc::getNoiseRange(Range);
+        // how long a single measurement takes, or in continuous mode the time between samples
+        static constexpr unsigned long MeasurementMicros = Mode == HmcContinuous ?
+            static_cast<unsigned long>(1e6 / MagnetoSensorHmc::getSampleRate(Rate)) : MagnetoSensorHmc::ConversionMicros;
+        // in continuous mode we allow for one missed sample
+        static constexpr unsigned long ReadyTimeoutMicros =
+            Mode == HmcContinuous ? 2 * MeasurementMicros : MagnetoSensorHmc::ConversionTimeoutMicros;
+
+        explicit HmcSensor(TwoWire* wire, const byte address = DefaultAddress) : _wire(wire), _address(address) {}
+
+        bool begin() {
+            softReset();
+            return true;
+        }
+
+        // Like with MagnetoSensorHmc, the first measurement after begin() still has the power-on gain (1.3 Ga).
+        // Same protocol as MagnetoSensorHmc::read. In single mode, this starts the next measurement
+        // and returns the previous one; in continuous mode, it returns false if there was no new sample.
+        bool read(SensorData& sample) {
+            if (Mode == HmcContinuous) return readContinuous(sample);
+            startMeasurement();
+            return readData(sample);
+        }
+
+        // read count samples, waiting for each up to the ready timeout. Returns the number of samples read.
+        // In single mode, read() returns the measurement it started the time before, so calling it in a loop would
+        // return samples right away without waiting for new ones. Here, each measurement is started and awaited.
+        // As with MagnetoSensorHmc, RDY still reports the previous result until the sensor writes the new one,
+        // so we don't look at it before the measurement had time to finish.
+        size_t readBatch(SensorData* samples, const size_t count, unsigned long* timestamps = nullptr) {
+            for (size_t i = 0; i < count; i++) {
+                const auto start = micros();
+                if (Mode != HmcContinuous) startMeasurement();
+                while (!collect(samples[i])) {
+                    if (micros() - start > ReadyTimeoutMicros) return i;
+                    waitUntil(_measurementStart + MeasurementMicros);
+                }
+                if (timestamps != nullptr) timestamps[i] = micros();
+            }
+            return count;
+        }
+
+        void softReset() {
+            // control A, control B and mode are adjacent, so one auto-increment write does it
+            const byte values[] = { ControlA, ControlB, ModeValue };
+            writeRegisters(_wire, _address, HmcControlA, values, 3);
+            markMeasurementStart();
+        }
+
+    private:
+        bool collect(SensorData& sample) {
+            if (Mode == HmcContinuous) return readContinuous(sample);
+            return micros() - _measurementStart >= MeasurementMicros && isReady() && readData(sample);
+        }
+
+        bool isReady() const {
+            requestFrom(_wire, _address, HmcStatus, 1);
+            return _wire->available() >= 1 && (_wire->read() & HmcReady) != 0;
+        }
+
+        void markMeasurementStart() {
+            _measurementStart = micros();
+            _hasLastData = false;
+        }
+
+        // the status register follows the data registers, so it comes in the same transaction. As reading doesn't
+        // clear RDY, the result is new if it changed since the last read or if a period passed since the last new one.
+        bool readContinuous(SensorData& sample) {
+            constexpr int BytesToRead = 7;
+            requestFrom(_wire, _address, HmcData, BytesToRead);
+            if (_wire->available() < BytesToRead) return false;
+            SensorData data{};
+            readHmcData(_wire, data);
+            const bool isReady = (_wire->read() & HmcReady) != 0;
+            const bool isChanged = _hasLastData && !(data == _lastData);
+            _lastData = data;
+            _hasLastData = true;
+            if (!isReady || !(isChanged || micros() - _measurementStart >= MeasurementMicros)) return false;
+            _measurementStart = micros();
+            sample = data;
+            return true;
+        }
+
+        bool readData(SensorData& sample) const {
+            constexpr int BytesToRead = 6;
+            requestFrom(_wire, _address, HmcData, BytesToRead);
+            if (_wire->available() < BytesToRead) return false;
+            readHmcData(_wire, sample);
+            return true;
+        }
+
+        void startMeasurement() {
+            writeRegister(_wire, _address, HmcMode, ModeValue);
+            markMeasurementStart();
+        }
+
+        TwoWire* _wire;
+        byte _address;
+        // when the last measurement was started, or in continuous mode when the last new sample came in
+        unsigned long _measurementStart = 0;
+        // in continuous mode, what the data registers held at the last read
+        SensorData _lastData{};
+        bool _hasLastData = false;
+    };
+
+    // C++11 needs these definitions when the constants are bound to references
+    template <HmcRange Range, HmcRate Rate, HmcOverSampling OverSampling, enum HmcMode Mode>
+    constexpr byte HmcSensor<Range, Rate, OverSampling, Mode>::DefaultAddress;
+    template <HmcRange Range, HmcRate Rate, HmcOverSampling OverSampling, enum HmcMode Mode>
+    constexpr byte HmcSensor<Range, Rate, OverSampling, Mode>::ControlA;
+    template <HmcRange Range, HmcRate Rate, HmcOverSampling OverSampling, enum HmcMode Mode>
+    constexpr byte HmcSensor<Range, Rate, OverSampling, Mode>::ControlB;
+    template <HmcRange Range, HmcRate Rate, HmcOverSampling OverSampling, enum HmcMode Mode>
+    constexpr byte HmcSensor<Range, Rate, OverSampling, Mode>::ModeValue;
+    template <HmcRange Range, HmcRate Rate, HmcOverSampling OverSampling, enum HmcMode Mode>
+    constexpr double HmcSensor<Range, Rate, OverSampling, Mode>::Gain;
+    template <HmcRange Range, HmcRate Rate, HmcOverSampling OverSampling, enum HmcMode Mode>
+    constexpr int HmcSensor<Range, Rate, OverSampling, Mode>::NoiseRange;
+    template <HmcRange Range, HmcRate Rate, HmcOverSampling OverSampling, enum HmcMode Mode>
+    constexpr unsigned long HmcSensor<Range, Rate, OverSampling, Mode>::MeasurementMicros;
+    template <HmcRange Range, HmcRate Rate, HmcOverSampling OverSampling, enum HmcMode Mode>
+    constexpr unsigned long HmcSensor<Range, Rate, OverSampling, Mode>::ReadyTimeoutMicros;
+}
+#endif
@@ -13,9 +13,16 @@
 #include "Wire.h"
 
 namespace MagnetoSensors {
+    constexpr unsigned long MagnetoSensor::DefaultPowerOffTimeoutMicros;
+    constexpr byte MagnetoSensor::ShadowSize;
+    // SensorStats is header only, so its constant gets its C++11 definition here
+    constexpr bool SensorStats::Enabled;
+
     MagnetoSensor::MagnetoSensor(const byte address, TwoWire* wire) : _address(address), _wire(wire) {}
 
     bool MagnetoSensor::begin() {
+        // the sensor may have been power cycled since we last wrote to it
+        forgetRegisters();
         softReset();
         return true;
     }
@@ -24,20 +31,117 @@ namespace MagnetoSensors {
         _address = address;
     }
 
+    void MagnetoSensor::configureNoiseEstimator(NoiseEstimator* estimator) {
+        _noiseEstimator = estimator;
+    }
+
+    void MagnetoSensor::configureTimeouts(const unsigned long dataTimeoutMicros, const unsigned long readyTimeoutMicros) {
+        _dataTimeoutMicros = dataTimeoutMicros;
+        _readyTimeoutMicros = readyTimeoutMicros;
+    }
+
+    unsigned long MagnetoSensor::getReadyTimeout(const unsigned long defaultTimeoutMicros) const {
+        return _readyTimeoutMicros == 0 ? defaultTimeoutMicros : _readyTimeoutMicros;
+    }
+
+    void MagnetoSensor::forgetRegister(const byte sensorRegister) const {
+        if (sensorRegister < ShadowSize) _knownRegisters &= static_cast<uint16_t>(~(1U << sensorRegister));
+    }
+
+    void MagnetoSensor::forgetRegisters() const {
+        _knownRegisters = 0;
+    }
+
+    bool MagnetoSensor::getRegister(const byte sensorRegister, byte& value) const {
+        if (!requestRegisters(sensorRegister, 1)) return false;
+        value = _wire->read();
+        return true;
+    }
+
+    const SensorStats& MagnetoSensor::getStats() const {
+        return _stats;
+    }
+
+    TwoWire* MagnetoSensor::getWire() const {
+        return _wire;
+    }
+
+    bool MagnetoSensor::hasNoiseEstimate() const {
+        return _noiseEstimator != nullptr && _noiseEstimator->isReady();
+    }
+
     bool MagnetoSensor::isOn() {
         _wire->beginTransmission(_address);
         return _wire->endTransmission() == 0;
     }
 
+    size_t MagnetoSensor::readBatch(SensorData* samples, const size_t count, unsigned long* timestamps) {
+        for (size_t i = 0; i < count; i++) {
+            if (!read(samples[i])) return i;
+            if (timestamps != nullptr) timestamps[i] = micros();
+        }
+        return count;
+    }
+
+    bool MagnetoSensor::requestRegisters(const byte firstRegister, const int count) const {
+        _stats.recordTransmission(requestFrom(_wire, _address, firstRegister, count));
+        const auto timestamp = micros();
+        while (_wire->available() < count) {
+            if (micros() - timestamp > _dataTimeoutMicros) {
+                _stats.recordTimeout();
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void MagnetoSensor::resetNoiseEstimate() const {
+        if (_noiseEstimator != nullptr) _noiseEstimator->reset();
+    }
+
+    void MagnetoSensor::resetStats() {
+        _stats.reset();
+    }
+
     void MagnetoSensor::setRegister(const byte sensorRegister, const byte value) const {
-        _wire->beginTransmission(_address);
-        _wire->write(sensorRegister);
-        _wire->write(value);
-        _wire->endTransmission();
+        setRegisters(sensorRegister, &value, 1);
     }
 
-    void MagnetoSensor::waitForPowerOff() {
-        while (isOn()) {}
+    void MagnetoSensor::setRegisters(const byte firstRegister, const byte* values, const byte count) const {
+        auto isKnown = [this, firstRegister, values](const byte index) {
+            const byte sensorRegister = static_cast<byte>(firstRegister + index);
+            return sensorRegister < ShadowSize && (_knownRegisters & (1U << sensorRegister)) != 0 &&
+                _shadow[sensorRegister] == values[index];
+        };
+        byte first = 0;
+        while (first < count && isKnown(first)) first++;
+        if (first == count) return;
+        byte end = count;
+        while (isKnown(end - 1)) end--;
+
+        const byte result = writeRegisters(_wire, _address, static_cast<byte>(firstRegister + first), values + first,
+                                           static_cast<byte>(end - first));
+        _stats.recordTransmission(result);
+        for (byte i = first; i < end; i++) {
+            const byte sensorRegister = static_cast<byte>(firstRegister + i);
+            if (sensorRegister >= ShadowSize) continue;
+            // if the sensor didn't take it, we don't know what is in there
+            if (result != 0) {
+                forgetRegister(sensorRegister);
+                continue;
+            }
+            _shadow[sensorRegister] = values[i];
+            _knownRegisters |= static_cast<uint16_t>(1U << sensorRegister);
+        }
+    }
+
+    bool MagnetoSensor::waitForPowerOff(const unsigned long timeoutMicros) {
+        const auto timestamp = micros();
+        while (isOn()) {
+            if (micros() - timestamp > timeoutMicros) return false;
+        }
+        forgetRegisters();
+        return true;
     }
 
     bool MagnetoSensor::handlePowerOn() {
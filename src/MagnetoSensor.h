@@ -25,7 +25,10 @@
 
 #include <ESP.h>
 #include <Wire.h>
+#include "NoiseEstimator.h"
+#include "SensorBus.h"
 #include "SensorData.h"
+#include "SensorStats.h"
 
 namespace MagnetoSensors {
 
@@ -46,12 +49,53 @@ namespace MagnetoSensors {
         // configure the wire address if not default (0x0D). Call before begin()
         void configureAddress(byte address);
 
+        // configure how long to wait for data on the bus, and for the sensor to get a new sample ready.
+        // A ready timeout of 0 means the sensor picks one based on its configuration.
+        void configureTimeouts(unsigned long dataTimeoutMicros, unsigned long readyTimeoutMicros = 0);
+
+        // Let getNoiseRange() return the noise measured from the samples read, once there is an estimate.
+        // The sensor feeds the samples it reads and resets the estimator when its gain changes. nullptr stops that.
+        void configureNoiseEstimator(NoiseEstimator* estimator);
+
+        // switch to the next more sensitive range. Returns false if the sensor is already at its narrowest range.
+        virtual bool decreaseRange() {
+            return false;
+        }
+
+        // the highest absolute value an axis can have without saturating
+        virtual int getCountLimit() const {
+            return SHRT_MAX;
+        }
+
         virtual double getGain() const = 0;
 
+        // the gain that decreaseRange() would switch to, or 0 if there is no more sensitive range
+        virtual double getLowerRangeGain() const {
+            return 0.0;
+        }
+
         virtual int getNoiseRange() const = 0;
 
+        // what happened in the hot paths so far. Always zero unless compiled with MAGNETOSENSOR_STATS
+        const SensorStats& getStats() const;
+
+        // the bus the sensor is on
+        TwoWire* getWire() const;
+
+        void resetStats();
+
         virtual bool handlePowerOn();
 
+        // whether the last sample was still measured with the gain from before a range change
+        virtual bool hasOldGain() const {
+            return false;
+        }
+
+        // switch to the next less sensitive range. Returns false if the sensor is already at its widest range.
+        virtual bool increaseRange() {
+            return false;
+        }
+
         // returns whether the sensor is active
         virtual bool isOn();
 
@@ -62,16 +106,56 @@ namespace MagnetoSensors {
         // read a sample from the sensor
         virtual bool read(SensorData& sample) = 0;
 
+        // read up to count samples into a caller supplied buffer, pacing them against the sensor's data ready status.
+        // If timestamps is not null, it gets the micros() value of each sample. Returns the number of samples read.
+        virtual size_t readBatch(SensorData* samples, size_t count, unsigned long* timestamps = nullptr);
+
         // soft reset the sensor
         virtual void softReset() = 0;
 
-        virtual void waitForPowerOff();
+        // Split-phase read, so sensors can convert while the bus does other work: start a measurement, then keep
+        // calling tryCollect until it returns true. By default there is nothing to start, and tryCollect just
+        // reads, which works for sensors that measure continuously and report whether the data was ready.
+        virtual void startSample() {}
+
+        virtual bool tryCollect(SensorData& sample) {
+            return read(sample);
+        }
+
+        // wait until the sensor stops answering, e.g. after cutting its power, but no longer than the timeout.
+        // Returns whether it went off.
+        virtual bool waitForPowerOff(unsigned long timeoutMicros = DefaultPowerOffTimeoutMicros);
+
+        static constexpr unsigned long DefaultPowerOffTimeoutMicros = 50000;
 
     protected:
-        static constexpr bool StopAfterSend = true;
+        static constexpr unsigned long DefaultDataTimeoutMicros = 10;
         byte _address;
         TwoWire* _wire;
+        unsigned long _dataTimeoutMicros = DefaultDataTimeoutMicros;
+        unsigned long _readyTimeoutMicros = 0;
+        // updated from const methods that talk to the sensor
+        mutable SensorStats _stats;
+        NoiseEstimator* _noiseEstimator = nullptr;
+        // shadow of the register contents we wrote, so we can skip writes that don't change anything
+        static constexpr byte ShadowSize = 16;
+        mutable byte _shadow[ShadowSize] {};
+        mutable uint16_t _knownRegisters = 0;
+        void estimateNoise(const SensorData& sample) const {
+            if (_noiseEstimator != nullptr) _noiseEstimator->add(sample);
+        }
+        bool hasNoiseEstimate() const;
+        void resetNoiseEstimate() const;
+        bool getRegister(byte sensorRegister, byte& value) const;
+        unsigned long getReadyTimeout(unsigned long defaultTimeoutMicros) const;
+        bool requestRegisters(byte firstRegister, int count) const;
+        // skipped if the shadow says the register already has the value
         void setRegister(byte sensorRegister, byte value) const;
+        // set adjacent registers in one auto-increment transaction, leaving out unchanged ones at either end
+        void setRegisters(byte firstRegister, const byte* values, byte count) const;
+        // for registers the sensor changes by itself (e.g. a mode that drops back to idle), and after resets
+        void forgetRegister(byte sensorRegister) const;
+        void forgetRegisters() const;
     };
 }
 #endif
@@ -0,0 +1,46 @@
+// Copyright 2024 Rik Essenius
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+// except in compliance with the License. You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and limitations under the License.
+
+// Makes a compile-time configured sensor (QmcSensor, HmcSensor) available as a MagnetoSensor,
+// for code that needs the runtime interface. The address is fixed at construction, so configureAddress doesn't apply.
+//
+// Example: MagnetoSensorAdapter<QmcSensor<QmcRange8G, QmcRate100Hz>> sensor(&Wire);
+
+#ifndef HEADER_MAGNETOSENSOR_ADAPTER
+#define HEADER_MAGNETOSENSOR_ADAPTER
+
+#include "MagnetoSensor.h"
+
+namespace MagnetoSensors {
+    template <class Sensor>
+    class MagnetoSensorAdapter final : public MagnetoSensor {
+    public:
+        explicit MagnetoSensorAdapter(TwoWire* wire, const byte address = Sensor::DefaultAddress) :
+            MagnetoSensor(address, wire), _sensor(wire, address) {}
+
+        bool begin() override { return _sensor.begin(); }
+        double getGain() const override { return Sensor::Gain; }
+        int getNoiseRange() const override { return Sensor::NoiseRange; }
+        Sensor& getSensor() { return _sensor; }
+        bool read(SensorData& sample) override { return _sensor.read(sample); }
+
+        // the sensor knows how to pace its samples: waiting for data ready, and in HMC single mode starting each one
+        size_t readBatch(SensorData* samples, const size_t count, unsigned long* timestamps = nullptr) override {
+            return _sensor.readBatch(samples, count, timestamps);
+        }
+
+        void softReset() override { _sensor.softReset(); }
+
+    private:
+        Sensor _sensor;
+    };
+}
+#endif
@@ -22,11 +22,43 @@
 #include "Wire.h"
 
 namespace MagnetoSensors {
+    constexpr unsigned long MagnetoSensorHmc::ConversionMicros;
+    constexpr unsigned long MagnetoSensorHmc::ConversionTimeoutMicros;
+
+    void readHmcData(TwoWire* wire, SensorData& sample) {
+        constexpr short Saturated = -4096;
+        // harmonize saturation values across sensors
+        auto readAxis = [wire] {
+            const short result = readWordMsbFirst(wire);
+            return result <= Saturated ? static_cast<short>(SHRT_MIN) : result;
+        };
+        // order: x, z, y
+        sample.x = readAxis();
+        sample.z = readAxis();
+        sample.y = readAxis();
+    }
+
     MagnetoSensorHmc::MagnetoSensorHmc(TwoWire* wire) : MagnetoSensor(DefaultAddress, wire) {}
 
-    void MagnetoSensorHmc::configure(const HmcRange range, const HmcBias bias) const {
-        setRegister(HmcControlA, _overSampling | _rate | bias);
-        setRegister(HmcControlB, range);
+    bool MagnetoSensorHmc::collect(SensorData& sample, const unsigned long startMicros) {
+        if (_mode == HmcContinuous) return readContinuous(sample, startMicros);
+        if (!isMeasurementDone()) {
+            _stats.recordStale();
+            return false;
+        }
+        return readData(sample, startMicros);
+    }
+
+    void MagnetoSensorHmc::configure(const HmcRange range, const HmcBias bias, const bool start) {
+        // control A, control B and mode are adjacent. Unchanged ones at the start are skipped.
+        const byte values[] = { static_cast<byte>(_overSampling | _rate | bias), static_cast<byte>(range), static_cast<byte>(_mode) };
+        if (start) forgetRegister(HmcMode);
+        setRegisters(HmcControlA, values, start ? 3 : 2);
+        if (start) markMeasurementStart();
+    }
+
+    void MagnetoSensorHmc::configureFastBoot(const bool fastBoot) {
+        _isFastBoot = fastBoot;
     }
 
     void MagnetoSensorHmc::configureRange(const HmcRange range) {
@@ -37,98 +69,207 @@ namespace MagnetoSensors {
         _overSampling = overSampling;
     }
 
-    void MagnetoSensorHmc::configureRate(const HmcRate rate) {
+    void MagnetoSensorHmc::configureRate(const HmcRate rate, const enum HmcMode mode) {
         _rate = rate;
+        _mode = mode;
+    }
+
+    bool MagnetoSensorHmc::decreaseRange() {
+        if (_range == HmcRange0_88) return false;
+        _stats.recordRangeDecrease();
+        switchRange(static_cast<HmcRange>(static_cast<int>(_range) - RangeStep));
+        return true;
+    }
+
+    void MagnetoSensorHmc::endSelfTest(const bool passed) {
+        _selfTest = passed ? HmcTestPassed : HmcTestFailed;
+        // a split-phase read that was started before the test needs a new measurement
+        configure(_range, HmcNone, _isSampling);
+        _isPipelined = !_isSampling;
+        markGainChange();
+    }
+
+    int MagnetoSensorHmc::getCountLimit() const {
+        return CountLimit;
     }
 
     double MagnetoSensorHmc::getGain() const {
         return getGain(_range);
     }
 
+    unsigned long MagnetoSensorHmc::getMeasurementMicros() const {
+        constexpr double MicrosPerSecond = 1e6;
+        // the first sample after switching to continuous mode also takes a period
+        if (_mode == HmcContinuous) return static_cast<unsigned long>(MicrosPerSecond / getSampleRate(_rate));
+        return ConversionMicros;
+    }
+
+    unsigned long MagnetoSensorHmc::getMeasurementTimeout() const {
+        // in continuous mode, allow for one missed sample
+        return getReadyTimeout(_mode == HmcContinuous ? 2 * getMeasurementMicros() : ConversionTimeoutMicros);
+    }
+
+    double MagnetoSensorHmc::getLowerRangeGain() const {
+        if (_range == HmcRange0_88) return 0.0;
+        return getGain(static_cast<HmcRange>(static_cast<int>(_range) - RangeStep));
+    }
+
+    HmcSelfTest MagnetoSensorHmc::getSelfTest() const {
+        return _selfTest;
+    }
+
     HmcRange MagnetoSensorHmc::getRange() const {
         return _range;
     }
 
     int MagnetoSensorHmc::getNoiseRange() const {
-        switch (_range) {
-            case HmcRange0_88: return 8;
-            case HmcRange1_3:
-            case HmcRange1_9: return 5;
-            case HmcRange2_5:
-            case HmcRange4_0: return 4;
-            case HmcRange4_7: return 3; // was 4
-            case HmcRange5_6:
-            case HmcRange8_1: return 2;
-        }
-        // should not happen
-        return 0;
-    }
-
-    double MagnetoSensorHmc::getGain(const HmcRange range) {
-        switch (range) {
-            case HmcRange0_88: return 1370.0;
-            case HmcRange1_3: return 1090.0;
-            case HmcRange1_9: return 820.0;
-            case HmcRange2_5: return 660.0;
-            case HmcRange4_0: return 440.0;
-            case HmcRange4_7: return 390.0;
-            case HmcRange5_6: return 330.0;
-            case HmcRange8_1: return 230.0;
-        }
-        // should not happen
-        return 0;
+        if (hasNoiseEstimate()) return _noiseEstimator->getNoiseRange();
+        return getNoiseRange(_range);
     }
 
-    void MagnetoSensorHmc::getTestMeasurement(SensorData& reading) {
-        startMeasurement();
+    void MagnetoSensorHmc::getTestMeasurement(SensorData& reading, const bool isStarted) {
+        if (!isStarted) startMeasurement();
         delay(5);
         read(reading);
     }
 
-    short MagnetoSensorHmc::readWord() const {
-        constexpr byte BitsPerByte = 8;
-
-        // preventing compiler optimization as read() has side effects
-        // order is MSB, LSB
-        short result = _wire->read() << BitsPerByte;
-        result |= _wire->read();
+    bool MagnetoSensorHmc::isMeasurementDone() const {
+        if (micros() - _measurementStart < getMeasurementMicros()) return false;
+        byte status;
+        return getRegister(HmcStatus, status) && (status & HmcReady) != 0;
+    }
 
-        // harmonize saturation values across sensors
-        if (result <= Saturated) {
-            result = SHRT_MIN;
+    HmcSelfTest MagnetoSensorHmc::pollSelfTest() {
+        if (_selfTest != HmcTestRunning) return _selfTest;
+        if (!isMeasurementDone()) {
+            if (micros() - _measurementStart > getMeasurementTimeout()) endSelfTest(false);
+            return _selfTest;
+        }
+        SensorData sample{};
+        if (!readData(sample, micros())) {
+            endSelfTest(false);
+            return _selfTest;
+        }
+        _selfTestMeasurements++;
+        if (_selfTestMeasurements == SelfTestMeasurements) {
+            endSelfTest(testInRange(sample));
+            return _selfTest;
         }
-        return result;
+        startMeasurement();
+        return _selfTest;
     }
 
     bool MagnetoSensorHmc::read(SensorData& sample) {
-        startMeasurement();
+        if (_selfTest == HmcTestRunning && pollSelfTest() == HmcTestRunning) return false;
+        const auto start = _stats.start();
+        _isPipelined = _mode != HmcContinuous;
+        if (_isPipelined) startMeasurement();
+        const bool success = _isPipelined ? readData(sample, start) : readContinuous(sample, start);
+        if (success) trackGain(sample);
+        return success;
+    }
 
-        _wire->beginTransmission(_address);
-        _wire->write(HmcData);
-        _wire->endTransmission();
+    size_t MagnetoSensorHmc::readBatch(SensorData* samples, const size_t count, unsigned long* timestamps) {
+        const unsigned long readyTimeout = getMeasurementTimeout();
+        // pollSelfTest ends the test on a timeout, so this doesn't hang. Don't poll before a measurement can be done.
+        while (pollSelfTest() == HmcTestRunning) waitForMeasurement();
+        _isPipelined = false;
+        for (size_t i = 0; i < count; i++) {
+            const auto start = _stats.start();
+            const auto waitStart = micros();
+            if (_mode != HmcContinuous) startMeasurement();
+            // no polling before the next sample can be there
+            while (!collect(samples[i], start)) {
+                if (micros() - waitStart > readyTimeout) return i;
+                waitForMeasurement();
+            }
+            trackGain(samples[i]);
+            if (timestamps != nullptr) timestamps[i] = micros();
+        }
+        return count;
+    }
 
+    bool MagnetoSensorHmc::readContinuous(SensorData& sample, const unsigned long startMicros) {
+        // The status register follows the data registers, so we get it in the same transaction.
+        // RDY only says that the data registers hold a complete result: reading doesn't clear it, the next write does.
+        // So the result is new if it changed since the last read, or if a period passed since the last new one.
+        constexpr int BytesToRead = 7;
+        if (!requestRegisters(HmcData, BytesToRead)) {
+            _stats.recordFailure();
+            return false;
+        }
+        SensorData data{};
+        readHmcData(_wire, data);
+        const bool isReady = (_wire->read() & HmcReady) != 0;
+        const bool isChanged = _hasLastData && !(data == _lastData);
+        _lastData = data;
+        _hasLastData = true;
+        if (!isReady || !(isChanged || micros() - _measurementStart >= getMeasurementMicros())) {
+            _stats.recordStale();
+            return false;
+        }
+        _measurementStart = micros();
+        sample = data;
+        _stats.recordRead(sample, startMicros);
+        return true;
+    }
+
+    bool MagnetoSensorHmc::readData(SensorData& sample, const unsigned long startMicros) const {
         //Read data from each axis, 2 registers per axis
         // order: x MSB, x LSB, z MSB, z LSB, y MSB, y LSB
         constexpr int BytesToRead = 6;
-        _wire->requestFrom(_address, BytesToRead, StopAfterSend);
-        const auto timestamp = micros();
-        while (_wire->available() < BytesToRead) {
-            if (micros() - timestamp > 10) return false;
+        if (!requestRegisters(HmcData, BytesToRead)) {
+            _stats.recordFailure();
+            return false;
         }
-        sample.x = readWord();
-        sample.z = readWord();
-        sample.y = readWord();
+        readHmcData(_wire, sample);
+        _stats.recordRead(sample, startMicros);
         return true;
     }
 
     void MagnetoSensorHmc::softReset() {
-        configure(_range, HmcNone);
+        // there is no reset command, so rewrite the whole configuration in case the sensor lost it (e.g. a brownout)
+        forgetRegisters();
+        _stats.recordSoftReset();
+        // the reset ends a running self test without a result
+        if (_selfTest == HmcTestRunning) _selfTest = HmcTestNotRun;
+        // get the first measurement going. With fast boot we don't wait for it, and the next read() returns it.
+        configure(_range, HmcNone, true);
+        // getTestMeasurement uses read()
+        _isPipelined = true;
+        markGainChange();
+        if (_isFastBoot) return;
         SensorData sample{};
-        getTestMeasurement(sample);
+        getTestMeasurement(sample, true);
     }
 
-    void MagnetoSensorHmc::startMeasurement() const {
-        setRegister(HmcMode, HmcSingle);
+    void MagnetoSensorHmc::startSelfTest() {
+        configure(HmcRange4_7, HmcPositive, true);
+        _selfTestMeasurements = 0;
+        _selfTest = HmcTestRunning;
+    }
+
+    void MagnetoSensorHmc::startSample() {
+        if (_mode != HmcContinuous) startMeasurement();
+        _isSampling = true;
+    }
+
+    void MagnetoSensorHmc::startMeasurement() {
+        // in continuous mode, this only needs to happen once after configuring.
+        // Writing the mode is what starts a measurement (and the sensor drops back to idle), so the shadow can't skip it.
+        forgetRegister(HmcMode);
+        setRegister(HmcMode, _mode);
+        markMeasurementStart();
+    }
+
+    bool MagnetoSensorHmc::tryCollect(SensorData& sample) {
+        if (!_isSampling) return false;
+        if (_selfTest == HmcTestRunning && pollSelfTest() == HmcTestRunning) return false;
+        if (!collect(sample, _stats.start())) return false;
+        _isPipelined = false;
+        _isSampling = false;
+        trackGain(sample);
+        return true;
     }
 
     bool MagnetoSensorHmc::testInRange(const SensorData& sample) {
@@ -142,35 +283,86 @@ namespace MagnetoSensors {
     }
 
     bool MagnetoSensorHmc::test() {
+        // this one replaces a non-blocking test that may be running
+        _selfTest = HmcTestNotRun;
         SensorData sample{};
 
-        configure(HmcRange4_7, HmcPositive);
+        configure(HmcRange4_7, HmcPositive, true);
 
         // read old value (still with old settings) 
-        getTestMeasurement(sample);
+        getTestMeasurement(sample, true);
         // the first one with new settings may still be a bit off
         getTestMeasurement(sample);
 
         // now do the test
         getTestMeasurement(sample);
         const bool passed = testInRange(sample);
+        _selfTest = passed ? HmcTestPassed : HmcTestFailed;
 
         // end self test mode
-        configure(_range, HmcNone);
+        configure(_range, HmcNone, true);
+        // getTestMeasurement uses read()
+        _isPipelined = true;
+        markGainChange();
         // skip the final measurement with the old gain
-        getTestMeasurement(sample);
+        getTestMeasurement(sample, true);
 
         return passed;
     }
 
     bool MagnetoSensorHmc::handlePowerOn() {
-        return test();
+        if (!_isFastBoot) return test();
+        startSelfTest();
+        return true;
+    }
+
+    bool MagnetoSensorHmc::hasChipId() const {
+        constexpr int IdLength = 3;
+        if (!requestRegisters(HmcIdentification, IdLength)) return false;
+        const int first = _wire->read();
+        const int second = _wire->read();
+        const int third = _wire->read();
+        return first == 'H' && second == '4' && third == '3';
+    }
+
+    bool MagnetoSensorHmc::hasOldGain() const {
+        return _hasOldGain;
     }
 
     bool MagnetoSensorHmc::increaseRange() {
         if (_range == HmcRange8_1) return false;
-        _range = static_cast<HmcRange>(static_cast<int>(_range) + 32);
-        softReset();
+        _stats.recordRangeIncrease();
+        switchRange(static_cast<HmcRange>(static_cast<int>(_range) + RangeStep));
         return true;
     }
+
+    void MagnetoSensorHmc::markGainChange() {
+        // The first measurement after writing ControlB still uses the old gain.
+        // read() in single mode returns the measurement started by the previous call, so there it's one more.
+        _oldGainSamples = _isPipelined && _mode != HmcContinuous ? 2 : 1;
+        resetNoiseEstimate();
+    }
+
+    void MagnetoSensorHmc::markMeasurementStart() {
+        _measurementStart = micros();
+        // what the data registers hold now is from before
+        _hasLastData = false;
+    }
+
+    void MagnetoSensorHmc::switchRange(const HmcRange range) {
+        // the gain is all that changes, so there is no need for a soft reset
+        _range = range;
+        setRegister(HmcControlB, _range);
+        markGainChange();
+    }
+
+    void MagnetoSensorHmc::trackGain(const SensorData& sample) {
+        _hasOldGain = _oldGainSamples > 0;
+        if (_hasOldGain) _oldGainSamples--;
+        else estimateNoise(sample);
+    }
+
+    void MagnetoSensorHmc::waitForMeasurement() const {
+        waitUntil(_measurementStart + getMeasurementMicros());
+    }
 }
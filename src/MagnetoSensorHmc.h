@@ -57,7 +57,8 @@ namespace MagnetoSensors {
         HmcControlB = 1,
         HmcMode = 2,
         HmcData = 3,
-        HmcStatus = 9
+        HmcStatus = 9,
+        HmcIdentification = 10
     };
 
     enum HmcBias : byte {
@@ -73,38 +74,142 @@ namespace MagnetoSensors {
         HmcIdle2 = 3
     };
 
+    // progress and result of the non-blocking self test
+    enum HmcSelfTest : byte {
+        HmcTestNotRun = 0,
+        HmcTestRunning = 1,
+        HmcTestPassed = 2,
+        HmcTestFailed = 3
+    };
+
+    enum HmcStatusFlag : byte {
+        HmcReady = 0b00000001,
+        HmcLock = 0b00000010
+    };
+
+    // Read a sample after requesting the data registers: x, z, y, each with the most significant byte first.
+    // Overflows (-4096) become SHRT_MIN, as with the QMC. Shared by MagnetoSensorHmc and HmcSensor.
+    void readHmcData(TwoWire* wire, SensorData& sample);
+
     class MagnetoSensorHmc final : public MagnetoSensor {
     public:
         explicit MagnetoSensorHmc(TwoWire* wire);
         void configureRange(HmcRange range);
         void configureOverSampling(HmcOverSampling overSampling);
-        void configureRate(HmcRate rate);
+        // configure the rate, and whether to measure continuously at that rate (default: single measurements).
+        // In continuous mode, read() doesn't need to start a measurement and just checks whether there is a new sample.
+        // (the HmcMode register name hides the HmcMode type, hence the elaborated type specifier)
+        void configureRate(HmcRate rate, enum HmcMode mode = HmcSingle);
+        // Fast boot: softReset() doesn't wait for a measurement, and handlePowerOn() only starts the self test
+        // (startSelfTest) and returns true. The result comes later, via getSelfTest().
+        void configureFastBoot(bool fastBoot);
         bool handlePowerOn() override;
-        bool increaseRange();
+        bool decreaseRange() override;
+        bool increaseRange() override;
+        int getCountLimit() const override;
         double getGain() const override;
+        double getLowerRangeGain() const override;
+        HmcSelfTest getSelfTest() const;
+        // whether the identification registers hold "H43", i.e. the chip is an HMC5883L
+        bool hasChipId() const;
+        bool hasOldGain() const override;
         HmcRange getRange() const;
         int getNoiseRange() const override;
-        static double getGain(HmcRange range);
+
+        // the tables behind the getters, also used by HmcSensor at compile time
+        static constexpr double getGain(const HmcRange range) {
+            return range == HmcRange0_88 ? 1370.0 : range == HmcRange1_3 ? 1090.0 : range == HmcRange1_9 ? 820.0 :
+                range == HmcRange2_5 ? 660.0 : range == HmcRange4_0 ? 440.0 : range == HmcRange4_7 ? 390.0 :
+                range == HmcRange5_6 ? 330.0 : range == HmcRange8_1 ? 230.0 : 0.0;
+        }
+
+        // the noise we expect without a noise estimator
+        static constexpr int getNoiseRange(const HmcRange range) {
+            return range == HmcRange0_88 ? 8 : range == HmcRange1_3 || range == HmcRange1_9 ? 5 :
+                range == HmcRange2_5 || range == HmcRange4_0 ? 4 : range == HmcRange4_7 ? 3 :
+                range == HmcRange5_6 || range == HmcRange8_1 ? 2 : 0;
+        }
+
+        // the sample rate in continuous mode, in Hz
+        static constexpr double getSampleRate(const HmcRate rate) {
+            return rate == HmcRate0_75 ? 0.75 : rate == HmcRate1_5 ? 1.5 : rate == HmcRate3_0 ? 3.0 :
+                rate == HmcRate7_5 ? 7.5 : rate == HmcRate15 ? 15.0 : rate == HmcRate30 ? 30.0 :
+                rate == HmcRate75 ? 75.0 : 0.0;
+        }
+
+        // a single measurement takes 6 ms (typical), and the highest rate in single mode is 160 Hz
+        static constexpr unsigned long ConversionMicros = 6250;
+        // allow some slack before giving up
+        static constexpr unsigned long ConversionTimeoutMicros = 10000;
+
         bool read(SensorData& sample) override;
+        size_t readBatch(SensorData* samples, size_t count, unsigned long* timestamps = nullptr) override;
         void softReset() override;
+
+        // Split-phase read: start a single measurement, then keep calling tryCollect until it returns true.
+        // That allows doing other work while the conversion runs.
+        void startSample() override;
+        bool tryCollect(SensorData& sample) override;
+
+        // Non-blocking self test: startSelfTest() switches on the positive bias and starts a measurement.
+        // pollSelfTest() takes the next step if the measurement is done, and returns the state.
+        // While the test runs, read() and tryCollect() drive it and return false; readBatch() finishes it first.
+        // Afterwards, the first samples are flagged with hasOldGain() as usual after a gain change.
+        HmcSelfTest pollSelfTest();
+        void startSelfTest();
+
         static bool testInRange(const SensorData& sample);
+        // the blocking self test. Takes about 30 ms.
         bool test();
 
     private:
         static constexpr byte DefaultAddress = 0x1E;
-        static constexpr int16_t Saturated = -4096;
-        void configure(HmcRange range, HmcBias bias) const;
-        void getTestMeasurement(SensorData& reading);
-        short readWord() const;
-        void startMeasurement() const;
+        // the data registers are 12 bit two's complement
+        static constexpr int CountLimit = 2047;
+        static constexpr int RangeStep = 32;
+        // the self test skips the first two biased measurements, as the new settings may not have fully applied yet
+        static constexpr byte SelfTestMeasurements = 3;
+        // read the next result: in continuous mode if there is a new one, in single mode if the measurement is done
+        bool collect(SensorData& sample, unsigned long startMicros);
+        // with start, the mode register gets written in the same transaction, which starts a measurement
+        void configure(HmcRange range, HmcBias bias, bool start = false);
+        void endSelfTest(bool passed);
+        // how long a single measurement takes, or in continuous mode the time between samples
+        unsigned long getMeasurementMicros() const;
+        unsigned long getMeasurementTimeout() const;
+        void getTestMeasurement(SensorData& reading, bool isStarted = false);
+        // RDY stays set until the sensor starts writing the next result, so right after starting a measurement
+        // it still reports the previous one. We only look at it once the measurement had time to finish.
+        bool isMeasurementDone() const;
+        void markGainChange();
+        void markMeasurementStart();
+        bool readContinuous(SensorData& sample, unsigned long startMicros);
+        bool readData(SensorData& sample, unsigned long startMicros) const;
+        void startMeasurement();
+        void switchRange(HmcRange range);
+        void trackGain(const SensorData& sample);
+        void waitForMeasurement() const;
 
         // 4.7 is not likely to get an overflow, and reasonably accurate
         HmcRange _range = HmcRange4_7;
-        // not really important as we use single measurements
+        // only relevant in continuous mode
         HmcRate _rate = HmcRate75;
+        enum HmcMode _mode = HmcSingle;
         // highest possible, to reduce noise
         HmcOverSampling _overSampling = HmcSampling8;
-        
+        bool _isSampling = false;
+        // when the last mode write started a measurement, or in continuous mode when the last new sample came in
+        unsigned long _measurementStart = 0;
+        // in continuous mode, what the data registers held at the last read
+        SensorData _lastData{};
+        bool _hasLastData = false;
+        // whether the last read returned the measurement started by the read before it (read() in single mode)
+        bool _isPipelined = false;
+        byte _oldGainSamples = 0;
+        bool _hasOldGain = false;
+        bool _isFastBoot = false;
+        HmcSelfTest _selfTest = HmcTestNotRun;
+        byte _selfTestMeasurements = 0;
     };
 }
 #endif
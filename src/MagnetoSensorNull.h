@@ -48,7 +48,9 @@ namespace MagnetoSensors {
 
         void softReset() override {}
 
-        void waitForPowerOff() override {}
+        bool waitForPowerOff(unsigned long /*timeoutMicros*/ = DefaultPowerOffTimeoutMicros) override {
+            return true;
+        }
     };
 }
 #endif
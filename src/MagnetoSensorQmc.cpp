@@ -22,12 +22,45 @@
 #include "Wire.h"
 
 namespace MagnetoSensors {
-    constexpr int SoftReset = 0x80;
+    namespace {
+        // mark the axes of a sample that had an overflow as saturated (SHRT_MIN)
+        void markSaturated(SensorData& sample) {
+            // the axes that hit the rails are the saturated ones. If none did, we take the one with the largest magnitude.
+            short* axes[] = { &sample.x, &sample.y, &sample.z };
+            short* largest = nullptr;
+            int largestMagnitude = -1;
+            bool found = false;
+            for (const auto axis : axes) {
+                if (*axis == SHRT_MAX || *axis == SHRT_MIN) {
+                    *axis = SHRT_MIN;
+                    found = true;
+                }
+                const int magnitude = *axis < 0 ? -*axis : *axis;
+                if (magnitude > largestMagnitude) {
+                    largest = axis;
+                    largestMagnitude = magnitude;
+                }
+            }
+            if (!found) *largest = SHRT_MIN;
+        }
+    }
+
+    byte readQmcData(TwoWire* wire, SensorData& sample) {
+        // order: status, x LSB, x MSB, y LSB, y MSB, z LSB, z MSB
+        const byte status = static_cast<byte>(wire->read());
+        sample.x = readWordLsbFirst(wire);
+        sample.y = readWordLsbFirst(wire);
+        sample.z = readWordLsbFirst(wire);
+        if ((status & QmcOverflow) != 0) markSaturated(sample);
+        return status;
+    }
 
     MagnetoSensorQmc::MagnetoSensorQmc(TwoWire* wire) : MagnetoSensor(DefaultAddress, wire) {}
 
     bool MagnetoSensorQmc::configure() const {
         setRegister(QmcSetReset, 0x01);
+        // read() starts at the status register and rolls over to the data
+        setRegister(QmcControl2, QmcRollOver);
         setRegister(QmcControl1, QmcContinuous | _rate | _range | _overSampling);
         return true;
     }
@@ -44,57 +77,99 @@ namespace MagnetoSensors {
         _rate = rate;
     }
 
-    // if we ever need DataReady, use (getRegister(QmcStatus) & 0x01) != 0;
+    bool MagnetoSensorQmc::decreaseRange() {
+        if (_range == QmcRange2G) return false;
+        _range = QmcRange2G;
+        _stats.recordRangeDecrease();
+        resetNoiseEstimate();
+        return configure();
+    }
+
+    int MagnetoSensorQmc::getCountLimit() const {
+        return CountLimit;
+    }
 
     double MagnetoSensorQmc::getGain() const {
         return getGain(_range);
     }
 
-    double MagnetoSensorQmc::getGain(const QmcRange range) {
-        if (range == QmcRange8G) return 3000.0;
-        return 12000.0;
+    double MagnetoSensorQmc::getLowerRangeGain() const {
+        return _range == QmcRange8G ? getGain(QmcRange2G) : 0.0;
     }
 
     QmcRange MagnetoSensorQmc::getRange() const {
         return _range;
     }
 
-    short MagnetoSensorQmc::readWord() const {
-        constexpr byte BitsPerByte = 8;
+    unsigned long MagnetoSensorQmc::getSkippedSamples() const {
+        return _skippedSamples;
+    }
+
+    bool MagnetoSensorQmc::hasChipId() const {
+        constexpr byte ChipId = 0xff;
+        byte value;
+        return getRegister(QmcChipId, value) && value == ChipId;
+    }
 
-        // preventing compiler optimization as read() has side effects
-        // order is LSB, MSB
-        short result = _wire->read();
-        result |= _wire->read() << BitsPerByte;
-        // if we got a positive saturation, shift it to SHRT_MIN as SHRT_MAX means an error
-        // We live with not testing this as the Wire mock can't handle word values unless byte values are the same
-        if (result == SHRT_MAX) result = SHRT_MIN;
-        return result;
+    bool MagnetoSensorQmc::increaseRange() {
+        if (_range == QmcRange8G) return false;
+        _range = QmcRange8G;
+        _stats.recordRangeIncrease();
+        resetNoiseEstimate();
+        return configure();
     }
 
     bool MagnetoSensorQmc::read(SensorData& sample) {
-        _wire->beginTransmission(_address);
-        _wire->write(QmcData);
-        _wire->endTransmission();
-
-        constexpr size_t BytesToRead = 6;
-        // Read data from each axis, 2 registers per axis
-        // order: x LSB, x MSB, y LSB, y MSB, z LSB, z MSB
-        _wire->requestFrom(_address, BytesToRead, StopAfterSend);
-        while (_wire->available() < BytesToRead) {}
-        sample.x = readWord();
-        sample.y = readWord();
-        sample.z = readWord();
+        // Read the status register, then the data from each axis, 2 registers per axis, in one burst.
+        // Reading a data register clears DRDY and DOR, so the status has to come first. configure() sets ROL_PNT,
+        // which makes the pointer roll over from the status register to the first data register.
+        // (Reading the status separately would also work, but takes an extra transaction per sample.)
+        constexpr int BytesToRead = 7;
+        const auto start = _stats.start();
+        if (!requestRegisters(QmcStatus, BytesToRead)) {
+            _stats.recordFailure();
+            return false;
+        }
+        SensorData data{};
+        const byte status = readQmcData(_wire, data);
+
+        if ((status & QmcDataSkipped) != 0) _skippedSamples++;
+        // no new data since the last read
+        if ((status & QmcDataReady) == 0) {
+            _stats.recordStale();
+            return false;
+        }
+        sample = data;
+        _stats.recordRead(sample, start);
+        estimateNoise(sample);
         return true;
     }
 
+    size_t MagnetoSensorQmc::readBatch(SensorData* samples, const size_t count, unsigned long* timestamps) {
+        // a new sample should be there within one period; by default allow for one missed sample
+        constexpr unsigned long MicrosPerSecond = 1000000UL;
+        const unsigned long readyTimeout = getReadyTimeout(2 * MicrosPerSecond / getSampleRate(_rate));
+        for (size_t i = 0; i < count; i++) {
+            const auto timestamp = micros();
+            while (!MagnetoSensorQmc::read(samples[i])) {
+                if (micros() - timestamp > readyTimeout) return i;
+            }
+            if (timestamps != nullptr) timestamps[i] = micros();
+        }
+        return count;
+    }
+
     void MagnetoSensorQmc::softReset() {
-        setRegister(QmcControl2, SoftReset);
+        _stats.recordSoftReset();
+        setRegister(QmcControl2, QmcSoftReset);
+        // the sensor is back at its defaults, and the reset bit clears itself
+        forgetRegisters();
+        resetNoiseEstimate();
         static_cast<void>(configure());
     }
 
     int MagnetoSensorQmc::getNoiseRange() const {
-        // only checked on 8 Gauss
-        return 60;
+        if (hasNoiseEstimate()) return _noiseEstimator->getNoiseRange();
+        return getNoiseRange(_range);
     }
 }
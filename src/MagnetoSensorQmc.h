@@ -49,7 +49,8 @@ namespace MagnetoSensors {
         QmcStatus = 0x06,
         QmcControl1 = 0x09,
         QmcControl2 = 0x0a,
-        QmcSetReset = 0x0b
+        QmcSetReset = 0x0b,
+        QmcChipId = 0x0d
     };
 
     enum QmcMode : byte {
@@ -57,6 +58,22 @@ namespace MagnetoSensors {
         QmcContinuous = 1
     };
 
+    enum QmcStatusFlag : byte {
+        QmcDataReady = 0b00000001,
+        QmcOverflow = 0b00000010,
+        QmcDataSkipped = 0b00000100
+    };
+
+    enum QmcControl2Flag : byte {
+        // after the status register, the read pointer rolls over to the first data register
+        QmcRollOver = 0b01000000,
+        QmcSoftReset = 0b10000000
+    };
+
+    // Read a sample after requesting the status and data registers (see MagnetoSensorQmc::read). Returns the status.
+    // With an overflow, the saturated axes get SHRT_MIN. Shared by MagnetoSensorQmc and QmcSensor.
+    byte readQmcData(TwoWire* wire, SensorData& sample);
+
     // QMC5883L sensor driver returning the raw readings.
 
     class MagnetoSensorQmc final : public MagnetoSensor {
@@ -75,15 +92,49 @@ namespace MagnetoSensors {
         // Note: lower rates won't work with the water meter as the code expects 100 Hz.
         void configureRate(QmcRate rate);
 
+        // switch from 8G to 2G. Doesn't reset the sensor, just reconfigures it.
+        bool decreaseRange() override;
+
+        // the sensor flags an overflow beyond its range (2 or 8 Gauss), which is the same count in both ranges
+        int getCountLimit() const override;
+
         double getGain() const override;
 
-        static double getGain(QmcRange range);
+        // the tables behind the getters, also used by QmcSensor at compile time
+        static constexpr double getGain(const QmcRange range) {
+            return range == QmcRange8G ? 3000.0 : 12000.0;
+        }
+
+        // the noise we expect without a noise estimator. Only checked on 8 Gauss.
+        static constexpr int getNoiseRange(QmcRange) {
+            return 60;
+        }
+
+        // the number of samples per second the sensor produces at the given rate
+        static constexpr unsigned int getSampleRate(const QmcRate rate) {
+            return rate == QmcRate10Hz ? 10 : rate == QmcRate50Hz ? 50 : rate == QmcRate100Hz ? 100 :
+                rate == QmcRate200Hz ? 200 : 0;
+        }
+
+        double getLowerRangeGain() const override;
 
         QmcRange getRange() const;
 
-        // read a sample from the sensor
+        // whether the chip ID register reads 0xFF, i.e. the chip is a QMC5883L
+        bool hasChipId() const;
+
+        // the number of times the sensor reported that it overwrote a sample we didn't read
+        unsigned long getSkippedSamples() const;
+
+        // switch from 2G to 8G. Doesn't reset the sensor, just reconfigures it.
+        bool increaseRange() override;
+
+        // read a sample from the sensor. Returns false if there was no new sample (or the sensor didn't respond)
         bool read(SensorData& sample) override;
 
+        // read samples as they become available (the sensor runs in continuous mode)
+        size_t readBatch(SensorData* samples, size_t count, unsigned long* timestamps = nullptr) override;
+
         // soft reset the sensor
         void softReset() override;
         int getNoiseRange() const override;
@@ -91,12 +142,12 @@ namespace MagnetoSensors {
 
     private:
         static constexpr byte DefaultAddress = 0x0D;
+        static constexpr int CountLimit = 24000;
         
         QmcOverSampling _overSampling = QmcSampling512;
         QmcRange _range = QmcRange8G;
         QmcRate _rate = QmcRate100Hz;
-
-        short readWord() const;
+        unsigned long _skippedSamples = 0;
     };
 }
 #endif
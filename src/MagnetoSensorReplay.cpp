@@ -0,0 +1,242 @@
+// Copyright 2024 Rik Essenius
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+// except in compliance with the License. You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and limitations under the License.
+
+#include "MagnetoSensorReplay.h"
+#include <cstring>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#define MAGNETOSENSOR_REPLAY_MAP
+#elif !defined(ESP_PLATFORM) && (defined(__unix__) || defined(__APPLE__))
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define MAGNETOSENSOR_REPLAY_MAP
+#endif
+
+namespace MagnetoSensors {
+    static_assert(sizeof(SensorData) == MagnetoSensorReplay::SampleSize, "samples are copied as is");
+
+    namespace {
+        constexpr char Magic[] = { 'M', 'S', 'R', 'P' };
+        constexpr size_t VersionOffset = 4;
+        constexpr size_t HeaderSizeOffset = 6;
+        constexpr size_t GainOffset = 8;
+        constexpr size_t NoiseRangeOffset = 16;
+        constexpr size_t SampleRateOffset = 20;
+        constexpr size_t SampleCountOffset = 24;
+        constexpr size_t EncodingOffset = 28;
+        constexpr unsigned long long MicrosPerSecond = 1000000ULL;
+
+        // the ESP32 and the hosts we run on are little endian, so we can copy the values as is.
+        template <typename T> T get(const byte* data, const size_t offset) {
+            T value;
+            memcpy(&value, data + offset, sizeof value);
+            return value;
+        }
+
+        template <typename T> void put(byte* data, const size_t offset, const T value) {
+            memcpy(data + offset, &value, sizeof value);
+        }
+    }
+
+    bool ReplayHeader::parse(const byte* data, const size_t size) {
+        if (data == nullptr || size < Size) return false;
+        if (memcmp(data, Magic, sizeof Magic) != 0) return false;
+        if (get<uint16_t>(data, VersionOffset) != Version) return false;
+        if (get<uint16_t>(data, HeaderSizeOffset) != Size) return false;
+        gain = get<double>(data, GainOffset);
+        noiseRange = get<int32_t>(data, NoiseRangeOffset);
+        sampleRate = get<uint32_t>(data, SampleRateOffset);
+        sampleCount = get<uint32_t>(data, SampleCountOffset);
+        encoding = static_cast<CaptureEncoding>(data[EncodingOffset]);
+        return encoding == CaptureRaw || encoding == CaptureDelta;
+    }
+
+    void ReplayHeader::write(byte* target) const {
+        memset(target, 0, Size);
+        memcpy(target, Magic, sizeof Magic);
+        put<uint16_t>(target, VersionOffset, Version);
+        put<uint16_t>(target, HeaderSizeOffset, Size);
+        put<double>(target, GainOffset, gain);
+        put<int32_t>(target, NoiseRangeOffset, noiseRange);
+        put<uint32_t>(target, SampleRateOffset, sampleRate);
+        put<uint32_t>(target, SampleCountOffset, sampleCount);
+        target[EncodingOffset] = encoding;
+    }
+
+    MagnetoSensorReplay::MagnetoSensorReplay() : MagnetoSensor(0, nullptr) {}
+
+    MagnetoSensorReplay::~MagnetoSensorReplay() {
+        close();
+    }
+
+    bool MagnetoSensorReplay::attach(const byte* capture, const size_t size) {
+        ReplayHeader header;
+        if (!header.parse(capture, size)) return false;
+        close();
+        _header = header;
+        _samples = capture + ReplayHeader::Size;
+        size_t available;
+        if (header.encoding == CaptureDelta) {
+            _reader = CaptureReader(_samples, size - ReplayHeader::Size);
+            available = header.sampleCount == 0 ? _reader.countSamples() : header.sampleCount;
+        }
+        else {
+            available = (size - ReplayHeader::Size) / SampleSize;
+        }
+        _sampleCount = header.sampleCount == 0 || header.sampleCount > available ? available : header.sampleCount;
+        _position = 0;
+        return true;
+    }
+
+    bool MagnetoSensorReplay::begin() {
+        rewind();
+        _startMicros = micros();
+        return isOn();
+    }
+
+    void MagnetoSensorReplay::close() {
+#if defined(_WIN32)
+        if (_mapping != nullptr) UnmapViewOfFile(_mapping);
+#elif defined(MAGNETOSENSOR_REPLAY_MAP)
+        if (_mapping != nullptr) munmap(_mapping, _mappingSize);
+#endif
+        _mapping = nullptr;
+        _mappingSize = 0;
+        _samples = nullptr;
+        _reader = CaptureReader();
+        _sampleCount = 0;
+        _position = 0;
+    }
+
+    void MagnetoSensorReplay::configurePacing(const bool realTime) {
+        _realTime = realTime;
+    }
+
+    double MagnetoSensorReplay::getGain() const {
+        return _header.gain;
+    }
+
+    int MagnetoSensorReplay::getNoiseRange() const {
+        return _header.noiseRange;
+    }
+
+    unsigned long MagnetoSensorReplay::getTimestamp(const size_t index) const {
+        if (_header.sampleRate == 0) return _startMicros;
+        return _startMicros + static_cast<unsigned long>(index * MicrosPerSecond / _header.sampleRate);
+    }
+
+    bool MagnetoSensorReplay::open(const char* path) {
+#if defined(_WIN32)
+        const HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) return false;
+        LARGE_INTEGER fileSize;
+        void* view = nullptr;
+        if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0) {
+            const HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (mapping != nullptr) {
+                view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+                // the view keeps the mapping alive
+                CloseHandle(mapping);
+            }
+        }
+        CloseHandle(file);
+        if (view == nullptr) return false;
+        const auto size = static_cast<size_t>(fileSize.QuadPart);
+        if (!attach(static_cast<const byte*>(view), size)) {
+            UnmapViewOfFile(view);
+            return false;
+        }
+#elif defined(MAGNETOSENSOR_REPLAY_MAP)
+        const int file = ::open(path, O_RDONLY);
+        if (file < 0) return false;
+        struct stat status {};
+        void* view = MAP_FAILED;
+        if (fstat(file, &status) == 0 && status.st_size > 0) {
+            view = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+        }
+        // the mapping stays valid after closing the file
+        ::close(file);
+        if (view == MAP_FAILED) return false;
+        const auto size = static_cast<size_t>(status.st_size);
+        // we read it front to back
+        madvise(view, size, MADV_SEQUENTIAL);
+        if (!attach(static_cast<const byte*>(view), size)) {
+            munmap(view, size);
+            return false;
+        }
+#else
+        static_cast<void>(path);
+        return false;
+#endif
+#if defined(MAGNETOSENSOR_REPLAY_MAP)
+        // attach() closed what we had, so only now take ownership
+        _mapping = view;
+        _mappingSize = size;
+        return true;
+#endif
+    }
+
+    bool MagnetoSensorReplay::read(SensorData& sample) {
+        if (_position >= _sampleCount) return false;
+        if (_realTime) waitFor(_position);
+        if (_header.encoding == CaptureDelta) {
+            if (_reader.read(&sample, 1) == 0) return false;
+        }
+        else {
+            memcpy(&sample, _samples + _position * SampleSize, SampleSize);
+        }
+        _position++;
+        return true;
+    }
+
+    size_t MagnetoSensorReplay::readBatch(SensorData* samples, const size_t count, unsigned long* timestamps) {
+        const size_t first = _position;
+        const size_t remaining = _sampleCount - _position;
+        const size_t toRead = count < remaining ? count : remaining;
+        if (_realTime) {
+            for (size_t i = 0; i < toRead && read(samples[i]); i++) {}
+        }
+        else if (_header.encoding == CaptureDelta) {
+            _position += _reader.read(samples, toRead);
+        }
+        else {
+            // the records have the same layout as SensorData, so we can copy them in one go
+            memcpy(samples, _samples + _position * SampleSize, toRead * SampleSize);
+            _position += toRead;
+        }
+        if (timestamps != nullptr) {
+            for (size_t i = first; i < _position; i++) {
+                timestamps[i - first] = getTimestamp(i);
+            }
+        }
+        return _position - first;
+    }
+
+    void MagnetoSensorReplay::rewind() {
+        _position = 0;
+        _reader.rewind();
+    }
+
+    void MagnetoSensorReplay::waitFor(const size_t index) const {
+        constexpr unsigned long MicrosPerMilli = 1000;
+        const unsigned long due = getTimestamp(index);
+        const long wait = static_cast<long>(due - micros());
+        if (wait <= 0) return;
+        if (wait >= static_cast<long>(MicrosPerMilli)) delay(wait / MicrosPerMilli);
+        while (static_cast<long>(due - micros()) > 0) {}
+    }
+}
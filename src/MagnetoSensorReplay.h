@@ -0,0 +1,115 @@
+// Copyright 2024 Rik Essenius
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+// except in compliance with the License. You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and limitations under the License.
+
+// Replays a recorded capture through the MagnetoSensor interface, so recorded production data
+// can go through the same code path as live data (e.g. to tune pattern detection offline).
+//
+// On a host, open() memory-maps the capture file, and samples are served straight from the mapping.
+// Delta encoded captures (see Capture.h) get decoded from the mapping on the fly.
+// On the ESP32 there is no file mapping; use attach() with a buffer that holds the capture (e.g. a flash partition).
+//
+// Replay can go as fast as possible, or paced at the recorded sample rate.
+// readBatch() timestamps are the recorded times relative to begin(), so downstream timing is right either way.
+
+#ifndef HEADER_MAGNETOSENSOR_REPLAY
+#define HEADER_MAGNETOSENSOR_REPLAY
+
+#include "Capture.h"
+#include "MagnetoSensor.h"
+
+namespace MagnetoSensors {
+
+    enum CaptureEncoding : byte {
+        // little endian x, y, z shorts
+        CaptureRaw = 0,
+        // blocks as written by CaptureWriter
+        CaptureDelta = 1
+    };
+
+    // Capture header, followed by the samples in the given encoding.
+    // Stored little endian with fixed offsets, so it doesn't depend on struct packing.
+
+    struct ReplayHeader {
+        static constexpr size_t Size = 32;
+        static constexpr uint16_t Version = 1;
+
+        double gain = 0;
+        int32_t noiseRange = 0;
+        uint32_t sampleRate = 0;
+        // 0 means: all samples until the end of the capture
+        uint32_t sampleCount = 0;
+        CaptureEncoding encoding = CaptureRaw;
+
+        // returns false if the data doesn't start with a valid header
+        bool parse(const byte* data, size_t size);
+        // target must have room for Size bytes
+        void write(byte* target) const;
+    };
+
+    class MagnetoSensorReplay final : public MagnetoSensor {
+    public:
+        static constexpr size_t SampleSize = 6;
+
+        MagnetoSensorReplay();
+        ~MagnetoSensorReplay() override;
+        MagnetoSensorReplay(const MagnetoSensorReplay&) = delete;
+        MagnetoSensorReplay(MagnetoSensorReplay&&) = delete;
+        MagnetoSensorReplay& operator=(const MagnetoSensorReplay&) = delete;
+        MagnetoSensorReplay& operator=(MagnetoSensorReplay&&) = delete;
+
+        // use a capture in memory. The buffer must outlive the replay. Returns false if it isn't a valid capture.
+        bool attach(const byte* capture, size_t size);
+
+        // memory-map a capture file. Returns false if that's not supported, or it isn't a valid capture.
+        bool open(const char* path);
+
+        void close();
+
+        // replay at the recorded rate (true) or as fast as possible (false, default)
+        void configurePacing(bool realTime);
+
+        // rewinds and starts the clock
+        bool begin() override;
+
+        double getGain() const override;
+        int getNoiseRange() const override;
+        size_t getPosition() const { return _position; }
+        unsigned int getSampleRate() const { return _header.sampleRate; }
+        size_t getSampleCount() const { return _sampleCount; }
+
+        bool isOn() override { return _samples != nullptr; }
+
+        // returns false at the end of the capture
+        bool read(SensorData& sample) override;
+        size_t readBatch(SensorData* samples, size_t count, unsigned long* timestamps = nullptr) override;
+
+        void rewind();
+
+        void softReset() override {}
+        bool waitForPowerOff(unsigned long /*timeoutMicros*/ = DefaultPowerOffTimeoutMicros) override { return true; }
+
+    private:
+        unsigned long getTimestamp(size_t index) const;
+        void waitFor(size_t index) const;
+
+        ReplayHeader _header;
+        CaptureReader _reader;
+        const byte* _samples = nullptr;
+        size_t _sampleCount = 0;
+        size_t _position = 0;
+        bool _realTime = false;
+        unsigned long _startMicros = 0;
+        // set when we mapped the capture ourselves
+        void* _mapping = nullptr;
+        size_t _mappingSize = 0;
+    };
+}
+#endif
@@ -0,0 +1,146 @@
+// Copyright 2024 Rik Essenius
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+// except in compliance with the License. You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and limitations under the License.
+
+#include "NoiseEstimator.h"
+#include <algorithm>
+#include <cmath>
+
+namespace MagnetoSensors {
+    namespace {
+        // sigma = 1.4826 * MAD for normally distributed values
+        constexpr float MadToSigma = 1.4826f;
+        // a difference of two samples has sqrt(2) times the noise of a sample
+        constexpr float Sqrt2 = 1.41421356f;
+        // rounding to counts gives at least 1/sqrt(12) noise per sample (and the MAD may well be 0)
+        constexpr float MinSigma = 0.28868f;
+        constexpr float MinDifferenceSigma = MinSigma * Sqrt2;
+        // more than this ratio between the standard deviation and the MAD based one means an outlier
+        constexpr float OutlierFactor = 2.0f;
+        // more than this ratio to the estimate so far means the window is not quiet
+        constexpr float LevelFactor = 2.0f;
+        // weight of a new window in the estimate is 1/Smoothing
+        constexpr float Smoothing = 8.0f;
+        constexpr float SigmasPerRange = 6.0f;
+
+        short clampToShort(const int value) {
+            if (value > SHRT_MAX) return SHRT_MAX;
+            if (value < -SHRT_MAX) return -SHRT_MAX;
+            return static_cast<short>(value);
+        }
+    }
+
+    constexpr size_t NoiseEstimator::WindowSize;
+    constexpr byte NoiseEstimator::MaxRejectedInRow;
+
+    void NoiseEstimator::add(const SensorData& sample) {
+        const short values[] = { sample.x, sample.y, sample.z };
+        if (sample.isSaturated()) {
+            // the difference with the next sample would be meaningless too
+            _isClean = false;
+            _hasPrevious = false;
+            return;
+        }
+        if (!_hasPrevious) {
+            std::copy(values, values + AxisCount, _previous);
+            _hasPrevious = true;
+            return;
+        }
+        const float n = static_cast<float>(_count + 1);
+        for (int axis = 0; axis < AxisCount; axis++) {
+            const short difference = clampToShort(values[axis] - _previous[axis]);
+            _previous[axis] = values[axis];
+            _differences[axis][_count] = difference;
+            const float delta = difference - _mean[axis];
+            _mean[axis] += delta / n;
+            _sumOfSquares[axis] += delta * (difference - _mean[axis]);
+        }
+        _count++;
+        if (_count == WindowSize) finishWindow();
+    }
+
+    void NoiseEstimator::finishWindow() {
+        // the standard deviation is the more accurate estimate; the MAD only serves to detect outliers
+        float sigma[AxisCount];
+        bool isQuiet = _isClean;
+        bool isAboveLevel = false;
+        for (int axis = 0; axis < AxisCount; axis++) {
+            sigma[axis] = std::sqrt(_sumOfSquares[axis] / static_cast<float>(WindowSize - 1)) / Sqrt2;
+            if (sigma[axis] < MinSigma) sigma[axis] = MinSigma;
+            if (sigma[axis] > OutlierFactor * getRobustSigma(axis) / Sqrt2) isQuiet = false;
+            if (_sigma[axis] > 0.0f && sigma[axis] > LevelFactor * _sigma[axis]) isAboveLevel = true;
+            _mean[axis] = 0.0f;
+            _sumOfSquares[axis] = 0.0f;
+        }
+        _count = 0;
+        _isClean = true;
+        if (!isQuiet) {
+            _rejectedWindows++;
+            return;
+        }
+        if (isAboveLevel) {
+            _rejectedInRow++;
+            if (_rejectedInRow < MaxRejectedInRow) {
+                _rejectedWindows++;
+                return;
+            }
+        }
+        // after a long noisy stretch, start over from the new level
+        const bool restart = _rejectedInRow >= MaxRejectedInRow;
+        _rejectedInRow = 0;
+        _acceptedWindows++;
+        for (int axis = 0; axis < AxisCount; axis++) {
+            if (_sigma[axis] == 0.0f || restart) _sigma[axis] = sigma[axis];
+            else _sigma[axis] += (sigma[axis] - _sigma[axis]) / Smoothing;
+        }
+    }
+
+    unsigned long NoiseEstimator::getAcceptedWindows() const {
+        return _acceptedWindows;
+    }
+
+    int NoiseEstimator::getNoiseRange() const {
+        float highest = 0.0f;
+        for (const auto sigma : _sigma) {
+            if (sigma > highest) highest = sigma;
+        }
+        return static_cast<int>(std::ceil(SigmasPerRange * highest));
+    }
+
+    float NoiseEstimator::getNoiseSigma(const int axis) const {
+        return _sigma[axis];
+    }
+
+    unsigned long NoiseEstimator::getRejectedWindows() const {
+        return _rejectedWindows;
+    }
+
+    float NoiseEstimator::getRobustSigma(const int axis) {
+        // works in place; the window is done with the differences anyway
+        short* values = _differences[axis];
+        constexpr size_t Middle = WindowSize / 2;
+        std::nth_element(values, values + Middle, values + WindowSize);
+        const short median = values[Middle];
+        for (size_t i = 0; i < WindowSize; i++) {
+            values[i] = clampToShort(std::abs(values[i] - median));
+        }
+        std::nth_element(values, values + Middle, values + WindowSize);
+        const float sigma = MadToSigma * values[Middle];
+        return sigma > MinDifferenceSigma ? sigma : MinDifferenceSigma;
+    }
+
+    bool NoiseEstimator::isReady() const {
+        return _acceptedWindows > 0;
+    }
+
+    void NoiseEstimator::reset() {
+        *this = NoiseEstimator();
+    }
+}
@@ -0,0 +1,70 @@
+// Copyright 2024 Rik Essenius
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+// except in compliance with the License. You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and limitations under the License.
+
+// Estimates the noise of a sensor from the samples it returns, in constant memory.
+//
+// It works on the differences between consecutive samples, which removes the field itself and most of a slow
+// pattern. It collects them in windows of WindowSize. Per window and axis, it calculates the standard deviation
+// (Welford) and the median absolute deviation (MAD). The MAD ignores the odd spike, the standard deviation does not.
+// So if the standard deviation is much larger than the MAD suggests, something happened in that window, and we
+// skip it. We also skip windows that are a lot noisier than the estimate so far (e.g. a fast pattern), unless that
+// goes on for MaxRejectedInRow windows; then the noise floor really went up.
+//
+// The estimate is an exponential average over the quiet windows. The noise range is about 6 sigma (so +/- 3 sigma)
+// of the per sample noise, in counts. Reset it when the gain changes, since the noise in counts changes with it.
+
+#ifndef HEADER_NOISE_ESTIMATOR
+#define HEADER_NOISE_ESTIMATOR
+
+#include "SensorData.h"
+
+namespace MagnetoSensors {
+    class NoiseEstimator {
+    public:
+        static constexpr size_t WindowSize = 32;
+        static constexpr byte MaxRejectedInRow = 16;
+
+        void add(const SensorData& sample);
+
+        unsigned long getAcceptedWindows() const;
+
+        // the noise range in counts: the highest of the axes, rounded up. 0 until the first quiet window.
+        int getNoiseRange() const;
+
+        // the estimated standard deviation of the noise of an axis (0 = x, 1 = y, 2 = z), in counts
+        float getNoiseSigma(int axis) const;
+
+        unsigned long getRejectedWindows() const;
+
+        bool isReady() const;
+
+        void reset();
+
+    private:
+        static constexpr int AxisCount = 3;
+        void finishWindow();
+        float getRobustSigma(int axis);
+
+        short _previous[AxisCount] {};
+        bool _hasPrevious = false;
+        bool _isClean = true;
+        size_t _count = 0;
+        short _differences[AxisCount][WindowSize] {};
+        // Welford state of the current window
+        float _mean[AxisCount] {};
+        float _sumOfSquares[AxisCount] {};
+        float _sigma[AxisCount] {};
+        byte _rejectedInRow = 0;
+        unsigned long _acceptedWindows = 0;
+        unsigned long _rejectedWindows = 0;
+    };
+}
+#endif
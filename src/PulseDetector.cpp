@@ -0,0 +1,139 @@
+// Copyright 2024 Rik Essenius
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+// except in compliance with the License. You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and limitations under the License.
+
+#include "PulseDetector.h"
+
+namespace MagnetoSensors {
+    constexpr byte PulseDetector::DefaultDecayShift;
+    constexpr int PulseDetector::AxisCount;
+    constexpr int PulseDetector::FractionBits;
+    constexpr int PulseDetector::SwitchQuarters;
+
+    PulseDetector::PulseDetector(const MagnetoSensor* sensor) : _sensor(sensor) {}
+
+    void PulseDetector::begin() {
+        _count = 0;
+        _pulses = 0;
+        restart();
+    }
+
+    void PulseDetector::choosePair() {
+        byte largest = 0;
+        for (byte axis = 1; axis < AxisCount; axis++) {
+            if (getSpan(axis) > getSpan(largest)) largest = axis;
+        }
+        // a circular field gives two axes about the same span; don't flap between them
+        if (largest != _primary && 4 * static_cast<int64_t>(getSpan(largest)) >
+            SwitchQuarters * static_cast<int64_t>(getSpan(_primary))) {
+            _primary = largest;
+            _level = LevelUnknown;
+        }
+        const byte first = _primary == 0 ? 1 : 0;
+        const byte second = _primary == 2 ? 1 : 2;
+        _secondary = getSpan(first) >= getSpan(second) ? first : second;
+    }
+
+    void PulseDetector::configureDecay(const byte shift) {
+        _decayShift = shift;
+    }
+
+    long PulseDetector::getCount() const {
+        return _count;
+    }
+
+    int32_t PulseDetector::getMiddle(const byte axis) const {
+        return _envelope[axis].low + getSpan(axis) / 2;
+    }
+
+    byte PulseDetector::getPrimaryAxis() const {
+        return _primary;
+    }
+
+    unsigned long PulseDetector::getPulses() const {
+        return _pulses;
+    }
+
+    byte PulseDetector::getSecondaryAxis() const {
+        return _secondary;
+    }
+
+    int32_t PulseDetector::getSpan(const byte axis) const {
+        return _envelope[axis].high - _envelope[axis].low;
+    }
+
+    void PulseDetector::restart() {
+        _hasEnvelope = false;
+        _level = LevelUnknown;
+        updateThreshold();
+    }
+
+    void PulseDetector::track(const byte axis, const int32_t value) {
+        Envelope& envelope = _envelope[axis];
+        if (!_hasEnvelope) {
+            envelope.high = value;
+            envelope.low = value;
+            return;
+        }
+        if (value > envelope.high) envelope.high = value;
+        if (value < envelope.low) envelope.low = value;
+        const int32_t step = (envelope.high - envelope.low) >> _decayShift;
+        envelope.high -= step;
+        envelope.low += step;
+    }
+
+    bool PulseDetector::update(const SensorData& sample, const unsigned long timestamp, PulseEvent& event) {
+        if (sample.isSaturated()) return false;
+        const short values[] = { sample.x, sample.y, sample.z };
+        for (byte axis = 0; axis < AxisCount; axis++) {
+            track(axis, static_cast<int32_t>(values[axis]) * (1 << FractionBits));
+        }
+        _hasEnvelope = true;
+        choosePair();
+
+        // the primary axis needs to swing well past the hysteresis on both sides
+        if (getSpan(_primary) <= 4 * _threshold) {
+            _level = LevelUnknown;
+            return false;
+        }
+        const int32_t value = static_cast<int32_t>(values[_primary]) * (1 << FractionBits) - getMiddle(_primary);
+        if (value < -_threshold) {
+            if (_level != LevelLow) updateThreshold();
+            _level = LevelLow;
+            return false;
+        }
+        if (value <= _threshold || _level == LevelHigh) return false;
+        const bool isRotation = _level == LevelLow;
+        _level = LevelHigh;
+        updateThreshold();
+        if (!isRotation) return false;
+
+        // going up on the primary axis, the secondary is at its low or high point depending on the direction
+        const int32_t secondary = static_cast<int32_t>(values[_secondary]) * (1 << FractionBits);
+        const signed char direction = secondary < getMiddle(_secondary) ? 1 : -1;
+        _count += direction;
+        _pulses++;
+        event = { timestamp, direction, _count };
+        return true;
+    }
+
+    bool PulseDetector::update(const TimedSample& sample, PulseEvent& event) {
+        // the envelopes are in counts of the old gain
+        if ((sample.flags & SampleGainChanged) != 0) restart();
+        if ((sample.flags & SampleOldGain) != 0) return false;
+        return update(sample.data, sample.timestamp, event);
+    }
+
+    void PulseDetector::updateThreshold() {
+        // the noise range covers the noise on both sides of the middle. Use at least one count.
+        const int noiseRange = _sensor == nullptr ? 0 : _sensor->getNoiseRange();
+        _threshold = noiseRange > 2 ? noiseRange * (1 << (FractionBits - 1)) : 1 << FractionBits;
+    }
+}
@@ -0,0 +1,101 @@
+// Copyright 2024 Rik Essenius
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+// except in compliance with the License. You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and limitations under the License.
+
+// Counts rotations of a magnet (e.g. in a water meter) from a stream of (preferably filtered) samples.
+//
+// A rotating magnet makes the field go round in a plane, so two axes show a sine, a quarter period apart.
+// Per axis, we keep an envelope (highest and lowest value) that slowly shrinks towards the middle, so it follows
+// changes in the field. The axis with the largest envelope is the primary one, the next largest the secondary.
+// A rotation is the primary axis crossing the middle upward. Crossings need to get past the noise range of the
+// sensor (half of it on either side of the middle), so noise around the middle doesn't make extra pulses.
+// The secondary axis tells the direction: it is on a different side of the middle for either direction.
+//
+// The work per sample is constant and no history is kept, so it can run in the sampling task.
+
+#ifndef HEADER_PULSE_DETECTOR
+#define HEADER_PULSE_DETECTOR
+
+#include "MagnetoSensor.h"
+#include "SampleRing.h"
+
+namespace MagnetoSensors {
+    struct PulseEvent {
+        unsigned long timestamp;
+        // 1 or -1. Which way is 1 depends on how the sensor is mounted.
+        signed char direction;
+        // the number of rotations so far: those with direction 1 minus those with direction -1
+        long count;
+    };
+
+    class PulseDetector {
+    public:
+        static constexpr byte DefaultDecayShift = 10;
+
+        // the sensor provides the noise range, in counts of its current range
+        explicit PulseDetector(const MagnetoSensor* sensor);
+
+        // the envelopes shrink by 1/2^shift of their size per sample. Make 2^shift well over the number of
+        // samples in the slowest rotation that must be counted.
+        void configureDecay(byte shift);
+
+        // forget the signal so far, including the count
+        void begin();
+
+        long getCount() const;
+        unsigned long getPulses() const;
+        // the axes used (0 = x, 1 = y, 2 = z)
+        byte getPrimaryAxis() const;
+        byte getSecondaryAxis() const;
+
+        // returns true if the sample completed a rotation, and then fills the event. Skips saturated samples.
+        bool update(const SensorData& sample, unsigned long timestamp, PulseEvent& event);
+
+        // same, for samples from a SampleRing. Starts over when the gain changes and skips samples with the old gain.
+        bool update(const TimedSample& sample, PulseEvent& event);
+
+    private:
+        static constexpr int AxisCount = 3;
+        // envelopes and thresholds have this many fraction bits, so they can shrink by small amounts
+        static constexpr int FractionBits = 8;
+        // another axis becomes primary if its envelope gets this much larger (in 1/4 of the current one)
+        static constexpr int SwitchQuarters = 5;
+
+        enum Level : byte {
+            LevelUnknown,
+            LevelLow,
+            LevelHigh
+        };
+
+        struct Envelope {
+            int32_t high;
+            int32_t low;
+        };
+
+        void choosePair();
+        int32_t getMiddle(byte axis) const;
+        int32_t getSpan(byte axis) const;
+        void restart();
+        void track(byte axis, int32_t value);
+        void updateThreshold();
+
+        const MagnetoSensor* _sensor;
+        byte _decayShift = DefaultDecayShift;
+        Envelope _envelope[AxisCount] {};
+        bool _hasEnvelope = false;
+        byte _primary = 0;
+        byte _secondary = 1;
+        Level _level = LevelUnknown;
+        int32_t _threshold = 0;
+        long _count = 0;
+        unsigned long _pulses = 0;
+    };
+}
+#endif
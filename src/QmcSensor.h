@@ -0,0 +1,99 @@
+// Copyright 2024 Rik Essenius
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+// except in compliance with the License. You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and limitations under the License.
+
+// QMC5883L sensor with the configuration fixed at compile time, for when it never changes after flashing.
+// The register values, gain and noise range are constants, and read() is not virtual so it can be inlined.
+// The tables and the bus protocol are the ones MagnetoSensorQmc uses. There are no statistics, and no register shadow
+// as the configuration is only written by softReset().
+// Use MagnetoSensorAdapter if you need it as a MagnetoSensor.
+//
+// Example: QmcSensor<QmcRange8G, QmcRate100Hz, QmcSampling512> sensor(&Wire);
+
+#ifndef HEADER_QMC_SENSOR
+#define HEADER_QMC_SENSOR
+
+#include "MagnetoSensorQmc.h"
+
+namespace MagnetoSensors {
+    template <QmcRange Range = QmcRange8G, QmcRate Rate = QmcRate100Hz, QmcOverSampling OverSampling = QmcSampling512>
+    class QmcSensor {
+    public:
+        static constexpr byte DefaultAddress = 0x0D;
+        static constexpr byte Control1 = static_cast<byte>(QmcContinuous | Rate | Range | OverSampling);
+        static constexpr double Gain = MagnetoSensorQmc::getGain(Range);
+        static constexpr int NoiseRange = MagnetoSensorQmc::getNoiseRange(Range);
+        static constexpr unsigned int SampleRate = MagnetoSensorQmc::getSampleRate(Rate);
+        // a new sample should be there within one period; allow for one missed sample
+        static constexpr unsigned long ReadyTimeoutMicros = 2 * 1000000UL / SampleRate;
+
+        explicit QmcSensor(TwoWire* wire, const byte address = DefaultAddress) : _wire(wire), _address(address) {}
+
+        bool begin() const {
+            softReset();
+            return true;
+        }
+
+        unsigned long getSkippedSamples() const { return _skippedSamples; }
+
+        // Same protocol as MagnetoSensorQmc::read: returns false if there was no new sample (or the sensor didn't respond)
+        bool read(SensorData& sample) {
+            constexpr int BytesToRead = 7;
+            // status first, as reading the data clears DRDY and DOR (see MagnetoSensorQmc::read)
+            requestFrom(_wire, _address, QmcStatus, BytesToRead);
+            if (_wire->available() < BytesToRead) return false;
+            SensorData data{};
+            const byte status = readQmcData(_wire, data);
+            if ((status & QmcDataSkipped) != 0) _skippedSamples++;
+            if ((status & QmcDataReady) == 0) return false;
+            sample = data;
+            return true;
+        }
+
+        // read count samples, waiting for each up to the ready timeout. Returns the number of samples read.
+        size_t readBatch(SensorData* samples, const size_t count, unsigned long* timestamps = nullptr) {
+            for (size_t i = 0; i < count; i++) {
+                const auto start = micros();
+                while (!read(samples[i])) {
+                    if (micros() - start > ReadyTimeoutMicros) return i;
+                }
+                if (timestamps != nullptr) timestamps[i] = micros();
+            }
+            return count;
+        }
+
+        void softReset() const {
+            writeRegister(_wire, _address, QmcControl2, QmcSoftReset);
+            writeRegister(_wire, _address, QmcSetReset, 0x01);
+            writeRegister(_wire, _address, QmcControl2, QmcRollOver);
+            writeRegister(_wire, _address, QmcControl1, Control1);
+        }
+
+    private:
+        TwoWire* _wire;
+        byte _address;
+        unsigned long _skippedSamples = 0;
+    };
+
+    // C++11 needs these definitions when the constants are bound to references
+    template <QmcRange Range, QmcRate Rate, QmcOverSampling OverSampling>
+    constexpr byte QmcSensor<Range, Rate, OverSampling>::DefaultAddress;
+    template <QmcRange Range, QmcRate Rate, QmcOverSampling OverSampling>
+    constexpr byte QmcSensor<Range, Rate, OverSampling>::Control1;
+    template <QmcRange Range, QmcRate Rate, QmcOverSampling OverSampling>
+    constexpr double QmcSensor<Range, Rate, OverSampling>::Gain;
+    template <QmcRange Range, QmcRate Rate, QmcOverSampling OverSampling>
+    constexpr int QmcSensor<Range, Rate, OverSampling>::NoiseRange;
+    template <QmcRange Range, QmcRate Rate, QmcOverSampling OverSampling>
+    constexpr unsigned int QmcSensor<Range, Rate, OverSampling>::SampleRate;
+    template <QmcRange Range, QmcRate Rate, QmcOverSampling OverSampling>
+    constexpr unsigned long QmcSensor<Range, Rate, OverSampling>::ReadyTimeoutMicros;
+}
+#endif
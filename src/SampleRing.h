@@ -0,0 +1,130 @@
+// Copyright 2024 Rik Essenius
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+// except in compliance with the License. You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and limitations under the License.
+
+// Fixed capacity ring buffer to hand timestamped samples from a sampling task to a processing task.
+// It is lock free for exactly one producer and one consumer: push and pop never wait.
+// The producer only writes the head, the consumer only writes the tail.
+// When the ring is full, push drops the new sample and counts an overrun.
+//
+// Sampler is a small helper for the producer side: it reads the sensor and pushes the result.
+// It tags samples around range changes, so the consumer knows when to apply a new gain.
+
+#ifndef HEADER_SAMPLE_RING
+#define HEADER_SAMPLE_RING
+
+#include <atomic>
+#include "MagnetoSensor.h"
+
+namespace MagnetoSensors {
+    enum SampleFlag : byte {
+        // the sensor's gain changed since the previous sample
+        SampleGainChanged = 0b00000001,
+        // the sample was still measured with the gain from before the change
+        SampleOldGain = 0b00000010
+    };
+
+    struct TimedSample {
+        SensorData data;
+        unsigned long timestamp;
+        // SampleFlag values
+        byte flags;
+    };
+
+    template <size_t Capacity>
+    class SampleRing {
+        static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of 2");
+
+    public:
+        static constexpr size_t capacity() { return Capacity; }
+
+        bool empty() const {
+            return size() == 0;
+        }
+
+        // the number of samples that were dropped because the ring was full
+        unsigned long getOverruns() const {
+            return _overruns.load(std::memory_order_relaxed);
+        }
+
+        // consumer only. Returns false if there was nothing to pop.
+        bool pop(TimedSample& sample) {
+            const size_t tail = _tail.load(std::memory_order_relaxed);
+            if (tail == _head.load(std::memory_order_acquire)) return false;
+            sample = _buffer[tail & Mask];
+            _tail.store(tail + 1, std::memory_order_release);
+            return true;
+        }
+
+        // consumer only. Pops up to maxCount samples in one go, returns the number of samples popped.
+        size_t drain(TimedSample* samples, const size_t maxCount) {
+            const size_t tail = _tail.load(std::memory_order_relaxed);
+            size_t count = _head.load(std::memory_order_acquire) - tail;
+            if (count > maxCount) count = maxCount;
+            for (size_t i = 0; i < count; i++) {
+                samples[i] = _buffer[(tail + i) & Mask];
+            }
+            _tail.store(tail + count, std::memory_order_release);
+            return count;
+        }
+
+        // producer only. Returns false (and counts an overrun) if the ring was full.
+        bool push(const TimedSample& sample) {
+            const size_t head = _head.load(std::memory_order_relaxed);
+            if (head - _tail.load(std::memory_order_acquire) == Capacity) {
+                // we are the only writer, so no need for a read-modify-write
+                _overruns.store(_overruns.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                return false;
+            }
+            _buffer[head & Mask] = sample;
+            _head.store(head + 1, std::memory_order_release);
+            return true;
+        }
+
+        bool push(const SensorData& data, const unsigned long timestamp, const byte flags = 0) {
+            return push(TimedSample{ data, timestamp, flags });
+        }
+
+        size_t size() const {
+            return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire);
+        }
+
+    private:
+        static constexpr size_t Mask = Capacity - 1;
+        TimedSample _buffer[Capacity] {};
+        // indexes keep increasing and wrap around naturally; the mask maps them onto the buffer
+        std::atomic<size_t> _head{ 0 };
+        std::atomic<size_t> _tail{ 0 };
+        std::atomic<unsigned long> _overruns{ 0 };
+    };
+
+    template <size_t Capacity>
+    class Sampler {
+    public:
+        Sampler(MagnetoSensor* sensor, SampleRing<Capacity>* ring) : _sensor(sensor), _ring(ring) {}
+
+        // read a sample and push it into the ring. Returns false if there was no sample or the ring was full.
+        bool sample() {
+            SensorData data{};
+            if (!_sensor->read(data)) return false;
+            byte flags = _sensor->hasOldGain() ? SampleOldGain : 0;
+            const double gain = _sensor->getGain();
+            if (_gain != 0.0 && gain != _gain) flags |= SampleGainChanged;
+            _gain = gain;
+            return _ring->push(data, micros(), flags);
+        }
+
+    private:
+        MagnetoSensor* _sensor;
+        SampleRing<Capacity>* _ring;
+        double _gain = 0.0;
+    };
+}
+#endif
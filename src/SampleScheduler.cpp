@@ -0,0 +1,100 @@
+// Copyright 2024 Rik Essenius
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+// except in compliance with the License. You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and limitations under the License.
+
+#include "SampleScheduler.h"
+
+namespace MagnetoSensors {
+    SampleScheduler::SampleScheduler(MagnetoSensor* sensor, const unsigned long periodMicros, const OverrunPolicy policy) :
+        _sensor(sensor), _periodMicros(periodMicros), _policy(policy) {}
+
+    void SampleScheduler::begin() {
+        _nextDeadline = micros();
+        resetStatistics();
+    }
+
+    void SampleScheduler::configureSpin(const unsigned long spinMicros) {
+        _spinMicros = spinMicros;
+    }
+
+    unsigned long SampleScheduler::getAverageJitter() const {
+        if (_slots == 0) return 0;
+        return static_cast<unsigned long>(_totalJitter / _slots);
+    }
+
+    unsigned long SampleScheduler::getMaxJitter() const {
+        return _maxJitter;
+    }
+
+    unsigned long SampleScheduler::getMissedSlots() const {
+        return _missedSlots;
+    }
+
+    unsigned long SampleScheduler::getSlots() const {
+        return _slots;
+    }
+
+    bool SampleScheduler::isDue() const {
+        return timeUntil(_nextDeadline) <= 0;
+    }
+
+    bool SampleScheduler::read(SensorData& sample) {
+        waitForSlot();
+        return _sensor->read(sample);
+    }
+
+    void SampleScheduler::resetStatistics() {
+        _slots = 0;
+        _missedSlots = 0;
+        _maxJitter = 0;
+        _totalJitter = 0;
+    }
+
+    long SampleScheduler::timeUntil(const unsigned long deadline) {
+        // works across micros() wrap-arounds as long as the deadline is less than ~35 minutes away
+        return static_cast<long>(deadline - micros());
+    }
+
+    unsigned long SampleScheduler::waitForSlot() {
+        const long spin = static_cast<long>(_spinMicros);
+        long remaining = timeUntil(_nextDeadline);
+        // delay() never returns late, but it may return up to a tick early. Then we go again.
+        while (remaining - spin >= static_cast<long>(MicrosPerMilli)) {
+            delay((remaining - spin) / MicrosPerMilli);
+            remaining = timeUntil(_nextDeadline);
+        }
+        // less than a tick to go, so delay() can't help. Let other tasks run in the meantime.
+        while (remaining > spin) {
+            yield();
+            remaining = timeUntil(_nextDeadline);
+        }
+        while (remaining > 0) {
+            remaining = timeUntil(_nextDeadline);
+        }
+
+        const unsigned long slot = _nextDeadline;
+        const unsigned long lateness = static_cast<unsigned long>(-remaining);
+        _slots++;
+        _totalJitter += lateness;
+        if (lateness > _maxJitter) _maxJitter = lateness;
+
+        const unsigned long slotsBehind = lateness / _periodMicros;
+        if (_policy == OverrunSkip) {
+            _missedSlots += slotsBehind;
+            _nextDeadline += (slotsBehind + 1) * _periodMicros;
+        }
+        else {
+            // the slots we are behind will still be served, but late
+            if (slotsBehind > 0) _missedSlots++;
+            _nextDeadline += _periodMicros;
+        }
+        return slot;
+    }
+}
@@ -0,0 +1,81 @@
+// Copyright 2024 Rik Essenius
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+// except in compliance with the License. You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and limitations under the License.
+
+// Drives a sensor at a fixed rate. Deadlines are absolute (start + n * period), so a late read doesn't shift
+// the rest of the schedule. While waiting, it gives the processor away: via delay() for whole milliseconds (which
+// blocks the task on the ESP32), and via yield() for the part below a tick. Only the last few microseconds are
+// spent spinning, to hit the slot accurately.
+//
+// When a read overruns into the next slot(s), the scheduler either catches up by running the missed slots
+// back to back, or skips them and continues at the next slot in the future.
+
+#ifndef HEADER_SAMPLE_SCHEDULER
+#define HEADER_SAMPLE_SCHEDULER
+
+#include "MagnetoSensor.h"
+
+namespace MagnetoSensors {
+
+    enum OverrunPolicy : byte {
+        OverrunCatchUp = 0,
+        OverrunSkip = 1
+    };
+
+    class SampleScheduler {
+    public:
+        SampleScheduler(MagnetoSensor* sensor, unsigned long periodMicros, OverrunPolicy policy = OverrunSkip);
+
+        // start the schedule; the first slot is due right away
+        void begin();
+
+        // how long before a slot to stop yielding and spin. Larger is more accurate if other tasks are busy,
+        // smaller leaves more processor time to them.
+        void configureSpin(unsigned long spinMicros);
+
+        // the average lateness of the slots so far, in microseconds
+        unsigned long getAverageJitter() const;
+
+        // the worst lateness of a slot so far, in microseconds
+        unsigned long getMaxJitter() const;
+
+        // the number of slots skipped (OverrunSkip) or served more than a period late (OverrunCatchUp)
+        unsigned long getMissedSlots() const;
+
+        unsigned long getSlots() const;
+
+        // returns whether the next slot is due, without waiting
+        bool isDue() const;
+
+        // wait for the next slot and read a sample. Returns the result of the read.
+        bool read(SensorData& sample);
+
+        void resetStatistics();
+
+        // wait for the next slot without reading. Returns the timestamp of the slot.
+        unsigned long waitForSlot();
+
+    private:
+        static constexpr unsigned long DefaultSpinMicros = 50;
+        static constexpr unsigned long MicrosPerMilli = 1000;
+        static long timeUntil(unsigned long deadline);
+
+        MagnetoSensor* _sensor;
+        unsigned long _periodMicros;
+        OverrunPolicy _policy;
+        unsigned long _spinMicros = DefaultSpinMicros;
+        unsigned long _nextDeadline = 0;
+        unsigned long _slots = 0;
+        unsigned long _missedSlots = 0;
+        unsigned long _maxJitter = 0;
+        unsigned long long _totalJitter = 0;
+    };
+}
+#endif
@@ -0,0 +1,194 @@
+// Copyright 2024 Rik Essenius
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+// except in compliance with the License. You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and limitations under the License.
+
+#include "SensorBlock.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define MAGNETOSENSOR_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MAGNETOSENSOR_SSE2
+#endif
+
+namespace MagnetoSensors {
+    namespace {
+        // The vector sums are 32 bit lanes that get two values (at most 2^16) per step.
+        // Moving them to 64 bits every 2^14 steps keeps them far from overflowing.
+        constexpr size_t StepsPerFlush = 16384;
+
+        void summarizeScalar(const short* values, const size_t begin, const size_t end, AxisSummary& summary) {
+            for (size_t i = begin; i < end; i++) {
+                const short value = values[i];
+                if (value < summary.min) summary.min = value;
+                if (value > summary.max) summary.max = value;
+                summary.sum += value;
+                summary.sumOfSquares += static_cast<uint64_t>(static_cast<int32_t>(value) * value);
+            }
+        }
+
+#if defined(MAGNETOSENSOR_AVX2)
+        constexpr size_t Lanes = 16;
+
+        size_t summarizeVector(const short* values, const size_t count, AxisSummary& summary) {
+            const size_t vectorEnd = count - count % Lanes;
+            if (vectorEnd == 0) return 0;
+            const __m256i ones = _mm256_set1_epi16(1);
+            const __m256i zero = _mm256_setzero_si256();
+            __m256i minimum = _mm256_set1_epi16(SHRT_MAX);
+            __m256i maximum = _mm256_set1_epi16(SHRT_MIN);
+            __m256i squares = zero;
+            size_t i = 0;
+            while (i < vectorEnd) {
+                const size_t flushEnd = vectorEnd - i > StepsPerFlush * Lanes ? i + StepsPerFlush * Lanes : vectorEnd;
+                __m256i sums = zero;
+                for (; i < flushEnd; i += Lanes) {
+                    const __m256i value = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i));
+                    minimum = _mm256_min_epi16(minimum, value);
+                    maximum = _mm256_max_epi16(maximum, value);
+                    sums = _mm256_add_epi32(sums, _mm256_madd_epi16(value, ones));
+                    // pairs of squares fit 32 bits unsigned, so widen them with zeros
+                    const __m256i square = _mm256_madd_epi16(value, value);
+                    squares = _mm256_add_epi64(squares, _mm256_unpacklo_epi32(square, zero));
+                    squares = _mm256_add_epi64(squares, _mm256_unpackhi_epi32(square, zero));
+                }
+                alignas(32) int32_t sumLanes[8];
+                _mm256_store_si256(reinterpret_cast<__m256i*>(sumLanes), sums);
+                for (const auto lane : sumLanes) summary.sum += lane;
+            }
+            alignas(32) short minLanes[Lanes];
+            alignas(32) short maxLanes[Lanes];
+            alignas(32) uint64_t squareLanes[4];
+            _mm256_store_si256(reinterpret_cast<__m256i*>(minLanes), minimum);
+            _mm256_store_si256(reinterpret_cast<__m256i*>(maxLanes), maximum);
+            _mm256_store_si256(reinterpret_cast<__m256i*>(squareLanes), squares);
+            for (size_t lane = 0; lane < Lanes; lane++) {
+                if (minLanes[lane] < summary.min) summary.min = minLanes[lane];
+                if (maxLanes[lane] > summary.max) summary.max = maxLanes[lane];
+            }
+            for (const auto lane : squareLanes) summary.sumOfSquares += lane;
+            return vectorEnd;
+        }
+
+        size_t containsVector(const short* values, const size_t count, const short value, bool& found) {
+            const size_t vectorEnd = count - count % Lanes;
+            const __m256i target = _mm256_set1_epi16(value);
+            for (size_t i = 0; i < vectorEnd; i += Lanes) {
+                const __m256i current = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i));
+                if (_mm256_movemask_epi8(_mm256_cmpeq_epi16(current, target)) != 0) {
+                    found = true;
+                    break;
+                }
+            }
+            return vectorEnd;
+        }
+
+#elif defined(MAGNETOSENSOR_SSE2)
+        constexpr size_t Lanes = 8;
+
+        size_t summarizeVector(const short* values, const size_t count, AxisSummary& summary) {
+            const size_t vectorEnd = count - count % Lanes;
+            if (vectorEnd == 0) return 0;
+            const __m128i ones = _mm_set1_epi16(1);
+            const __m128i zero = _mm_setzero_si128();
+            __m128i minimum = _mm_set1_epi16(SHRT_MAX);
+            __m128i maximum = _mm_set1_epi16(SHRT_MIN);
+            __m128i squares = zero;
+            size_t i = 0;
+            while (i < vectorEnd) {
+                const size_t flushEnd = vectorEnd - i > StepsPerFlush * Lanes ? i + StepsPerFlush * Lanes : vectorEnd;
+                __m128i sums = zero;
+                for (; i < flushEnd; i += Lanes) {
+                    const __m128i value = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i));
+                    minimum = _mm_min_epi16(minimum, value);
+                    maximum = _mm_max_epi16(maximum, value);
+                    sums = _mm_add_epi32(sums, _mm_madd_epi16(value, ones));
+                    // pairs of squares fit 32 bits unsigned, so widen them with zeros
+                    const __m128i square = _mm_madd_epi16(value, value);
+                    squares = _mm_add_epi64(squares, _mm_unpacklo_epi32(square, zero));
+                    squares = _mm_add_epi64(squares, _mm_unpackhi_epi32(square, zero));
+                }
+                alignas(16) int32_t sumLanes[4];
+                _mm_store_si128(reinterpret_cast<__m128i*>(sumLanes), sums);
+                for (const auto lane : sumLanes) summary.sum += lane;
+            }
+            alignas(16) short minLanes[Lanes];
+            alignas(16) short maxLanes[Lanes];
+            alignas(16) uint64_t squareLanes[2];
+            _mm_store_si128(reinterpret_cast<__m128i*>(minLanes), minimum);
+            _mm_store_si128(reinterpret_cast<__m128i*>(maxLanes), maximum);
+            _mm_store_si128(reinterpret_cast<__m128i*>(squareLanes), squares);
+            for (size_t lane = 0; lane < Lanes; lane++) {
+                if (minLanes[lane] < summary.min) summary.min = minLanes[lane];
+                if (maxLanes[lane] > summary.max) summary.max = maxLanes[lane];
+            }
+            for (const auto lane : squareLanes) summary.sumOfSquares += lane;
+            return vectorEnd;
+        }
+
+        size_t containsVector(const short* values, const size_t count, const short value, bool& found) {
+            const size_t vectorEnd = count - count % Lanes;
+            const __m128i target = _mm_set1_epi16(value);
+            for (size_t i = 0; i < vectorEnd; i += Lanes) {
+                const __m128i current = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i));
+                if (_mm_movemask_epi8(_mm_cmpeq_epi16(current, target)) != 0) {
+                    found = true;
+                    break;
+                }
+            }
+            return vectorEnd;
+        }
+
+#else
+        size_t summarizeVector(const short*, size_t, AxisSummary&) {
+            return 0;
+        }
+
+        size_t containsVector(const short*, size_t, short, bool&) {
+            return 0;
+        }
+#endif
+    }
+
+    bool BlockKernels::contains(const short* values, const size_t count, const short value) {
+        bool found = false;
+        const size_t done = containsVector(values, count, value, found);
+        if (found) return true;
+        for (size_t i = done; i < count; i++) {
+            if (values[i] == value) return true;
+        }
+        return false;
+    }
+
+    void BlockKernels::merge(const short* x, const short* y, const short* z, const size_t count, SensorData* samples) {
+        for (size_t i = 0; i < count; i++) {
+            samples[i].x = x[i];
+            samples[i].y = y[i];
+            samples[i].z = z[i];
+        }
+    }
+
+    void BlockKernels::split(const SensorData* samples, const size_t count, short* x, short* y, short* z) {
+        for (size_t i = 0; i < count; i++) {
+            x[i] = samples[i].x;
+            y[i] = samples[i].y;
+            z[i] = samples[i].z;
+        }
+    }
+
+    AxisSummary BlockKernels::summarize(const short* values, const size_t count) {
+        if (count == 0) return { 0, 0, 0, 0 };
+        AxisSummary summary{ SHRT_MAX, SHRT_MIN, 0, 0 };
+        const size_t done = summarizeVector(values, count, summary);
+        summarizeScalar(values, done, count, summary);
+        return summary;
+    }
+}
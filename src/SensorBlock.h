@@ -0,0 +1,105 @@
+// Copyright 2024 Rik Essenius
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+// except in compliance with the License. You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and limitations under the License.
+
+// A block of samples stored per axis (structure of arrays), which suits vector processing better than
+// an array of SensorData. The reductions run on SSE2 or AVX2 when the compiler targets those
+// (x86-64 hosts always have SSE2), and fall back to plain loops elsewhere, e.g. on the ESP32.
+
+#ifndef HEADER_SENSOR_BLOCK
+#define HEADER_SENSOR_BLOCK
+
+#include "SensorData.h"
+
+namespace MagnetoSensors {
+    struct AxisSummary {
+        short min;
+        short max;
+        int64_t sum;
+        uint64_t sumOfSquares;
+    };
+
+    struct BlockSummary {
+        size_t count;
+        AxisSummary x;
+        AxisSummary y;
+        AxisSummary z;
+    };
+
+    // The kernels behind SensorBlock. They work on any array, aligned or not.
+
+    class BlockKernels {
+    public:
+        // min and max are 0 if count is 0
+        static AxisSummary summarize(const short* values, size_t count);
+        static bool contains(const short* values, size_t count, short value);
+        static void split(const SensorData* samples, size_t count, short* x, short* y, short* z);
+        static void merge(const short* x, const short* y, const short* z, size_t count, SensorData* samples);
+    };
+
+    template <size_t Capacity>
+    class SensorBlock {
+        static_assert(Capacity > 0 && Capacity % 16 == 0, "Capacity must be a multiple of 16 (one AVX2 vector)");
+
+    public:
+        static constexpr size_t capacity() { return Capacity; }
+        size_t size() const { return _size; }
+        bool empty() const { return _size == 0; }
+        bool full() const { return _size == Capacity; }
+        void clear() { _size = 0; }
+
+        const short* getX() const { return _x; }
+        const short* getY() const { return _y; }
+        const short* getZ() const { return _z; }
+
+        SensorData get(const size_t index) const { return { _x[index], _y[index], _z[index] }; }
+
+        // replace the content with up to Capacity samples. Returns the number of samples loaded.
+        size_t load(const SensorData* samples, const size_t count) {
+            _size = count < Capacity ? count : Capacity;
+            BlockKernels::split(samples, _size, _x, _y, _z);
+            return _size;
+        }
+
+        // returns false if the block is full
+        bool push(const SensorData& sample) {
+            if (full()) return false;
+            _x[_size] = sample.x;
+            _y[_size] = sample.y;
+            _z[_size] = sample.z;
+            _size++;
+            return true;
+        }
+
+        // write all samples to a buffer with room for size() samples
+        void store(SensorData* samples) const {
+            BlockKernels::merge(_x, _y, _z, _size, samples);
+        }
+
+        // same as SensorData::isSaturated, for any of the samples
+        bool isSaturated() const {
+            return BlockKernels::contains(_x, _size, SHRT_MIN) ||
+                BlockKernels::contains(_y, _size, SHRT_MIN) ||
+                BlockKernels::contains(_z, _size, SHRT_MIN);
+        }
+
+        // min, max, sum and sum of squares per axis
+        BlockSummary summarize() const {
+            return { _size, BlockKernels::summarize(_x, _size), BlockKernels::summarize(_y, _size), BlockKernels::summarize(_z, _size) };
+        }
+
+    private:
+        alignas(32) short _x[Capacity];
+        alignas(32) short _y[Capacity];
+        alignas(32) short _z[Capacity];
+        size_t _size = 0;
+    };
+}
+#endif
@@ -0,0 +1,75 @@
+// Copyright 2024 Rik Essenius
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+// except in compliance with the License. You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and limitations under the License.
+
+// Byte level helpers for talking to the sensors, shared by the drivers and the compile-time configured sensors
+// (QmcSensor, HmcSensor). They don't keep statistics or use the register shadow: MagnetoSensor adds that around them,
+// while the templates write a fixed configuration and have no runtime state to track.
+
+#ifndef HEADER_SENSOR_BUS
+#define HEADER_SENSOR_BUS
+
+#include <ESP.h>
+#include <Wire.h>
+
+namespace MagnetoSensors {
+    // point the sensor at the first register, and ask for count bytes from there on.
+    // Returns the result of endTransmission. The bytes may take a bit to become available.
+    inline byte requestFrom(TwoWire* wire, const byte address, const byte firstRegister, const int count) {
+        wire->beginTransmission(address);
+        wire->write(firstRegister);
+        const byte result = wire->endTransmission();
+        wire->requestFrom(address, count, true);
+        return result;
+    }
+
+    // the next two bytes on the bus as a word, most significant byte first (HMC)
+    inline short readWordMsbFirst(TwoWire* wire) {
+        // two statements, since the order of the reads matters
+        short result = static_cast<short>(wire->read() << 8);
+        result = static_cast<short>(result | wire->read());
+        return result;
+    }
+
+    // the next two bytes on the bus as a word, least significant byte first (QMC)
+    inline short readWordLsbFirst(TwoWire* wire) {
+        short result = static_cast<short>(wire->read());
+        result = static_cast<short>(result | wire->read() << 8);
+        return result;
+    }
+
+    // write adjacent registers in one auto-increment transaction. Returns the result of endTransmission.
+    inline byte writeRegisters(TwoWire* wire, const byte address, const byte firstRegister, const byte* values,
+                               const byte count) {
+        wire->beginTransmission(address);
+        wire->write(firstRegister);
+        for (byte i = 0; i < count; i++) wire->write(values[i]);
+        return wire->endTransmission();
+    }
+
+    inline byte writeRegister(TwoWire* wire, const byte address, const byte sensorRegister, const byte value) {
+        return writeRegisters(wire, address, sensorRegister, &value, 1);
+    }
+
+    // wait without blocking other tasks: delay() for whole milliseconds, yield() for the rest.
+    // Yields at least once, so it also works as a pause between polls. Works across micros() wrap-arounds.
+    inline void waitUntil(const unsigned long deadlineMicros) {
+        constexpr long MicrosPerMilli = 1000;
+        long remaining = static_cast<long>(deadlineMicros - micros());
+        while (remaining >= MicrosPerMilli) {
+            delay(remaining / MicrosPerMilli);
+            remaining = static_cast<long>(deadlineMicros - micros());
+        }
+        do {
+            yield();
+        } while (static_cast<long>(deadlineMicros - micros()) > 0);
+    }
+}
+#endif
@@ -0,0 +1,76 @@
+// Copyright 2024 Rik Essenius
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+// except in compliance with the License. You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and limitations under the License.
+
+#include "SensorDetector.h"
+#include <new>
+
+namespace MagnetoSensors {
+    constexpr byte SensorDetector::MaxBuses;
+
+    SensorDetector::~SensorDetector() {
+        for (byte slot = 0; slot < MaxBuses; slot++) clear(slot);
+    }
+
+    void SensorDetector::clear(const byte slot) {
+        Slot& current = _slots[slot];
+        if (current.sensor != nullptr) current.sensor->~MagnetoSensor();
+        current.sensor = nullptr;
+        current.type = SensorNone;
+    }
+
+    MagnetoSensor* SensorDetector::detect(const byte slot, TwoWire* wire) {
+        if (slot >= MaxBuses) return &_null;
+        clear(slot);
+        if (tryDriver<MagnetoSensorHmc>(slot, wire, SensorHmc) || tryDriver<MagnetoSensorQmc>(slot, wire, SensorQmc)) {
+            return _slots[slot].sensor;
+        }
+        return &_null;
+    }
+
+    byte SensorDetector::detect(TwoWire* const* wires, const byte count, MagnetoSensor** sensors) {
+        byte found = 0;
+        for (byte slot = 0; slot < count; slot++) {
+            sensors[slot] = detect(slot, wires[slot]);
+            if (sensors[slot]->isReal()) found++;
+        }
+        return found;
+    }
+
+    MagnetoSensorHmc* SensorDetector::getHmc(const byte slot) const {
+        return getType(slot) == SensorHmc ? static_cast<MagnetoSensorHmc*>(_slots[slot].sensor) : nullptr;
+    }
+
+    MagnetoSensorQmc* SensorDetector::getQmc(const byte slot) const {
+        return getType(slot) == SensorQmc ? static_cast<MagnetoSensorQmc*>(_slots[slot].sensor) : nullptr;
+    }
+
+    MagnetoSensor* SensorDetector::getSensor(const byte slot) {
+        if (getType(slot) == SensorNone) return &_null;
+        return _slots[slot].sensor;
+    }
+
+    SensorType SensorDetector::getType(const byte slot) const {
+        return slot < MaxBuses ? _slots[slot].type : SensorNone;
+    }
+
+    template <class Driver>
+    bool SensorDetector::tryDriver(const byte slot, TwoWire* wire, const SensorType type) {
+        // constructing a driver doesn't touch the bus, so this is cheap when nothing answers
+        auto driver = new (&_slots[slot].storage) Driver(wire);
+        if (driver->isOn() && driver->hasChipId() && driver->begin()) {
+            _slots[slot].sensor = driver;
+            _slots[slot].type = type;
+            return true;
+        }
+        driver->~Driver();
+        return false;
+    }
+}
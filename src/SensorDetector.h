@@ -0,0 +1,85 @@
+// Copyright 2024 Rik Essenius
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+// except in compliance with the License. You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and limitations under the License.
+
+// Finds out which sensor is on a bus, and returns a driver for it: MagnetoSensorHmc, MagnetoSensorQmc,
+// or MagnetoSensorNull if there is none (or it doesn't identify itself).
+//
+// Per bus, it pings the HMC address (0x1E) and the QMC address (0x0D), the way isOn() does. Only a chip that
+// answers gets its identification registers read, and only an identified chip gets begin(). So a missing sensor
+// costs two address pings, and no timeouts or delays.
+//
+// The drivers live in the detector (one slot per bus), so there are no allocations. A driver stays valid until
+// the next detect() for the same slot, or until the detector goes. Configure the driver via getHmc()/getQmc()
+// and call its begin() again if the defaults don't fit.
+
+#ifndef HEADER_SENSOR_DETECTOR
+#define HEADER_SENSOR_DETECTOR
+
+#include <type_traits>
+#include "MagnetoSensorHmc.h"
+#include "MagnetoSensorNull.h"
+#include "MagnetoSensorQmc.h"
+
+namespace MagnetoSensors {
+    enum SensorType : byte {
+        SensorNone = 0,
+        SensorHmc = 1,
+        SensorQmc = 2
+    };
+
+    class SensorDetector {
+    public:
+        static constexpr byte MaxBuses = 2;
+
+        SensorDetector() = default;
+        ~SensorDetector();
+        SensorDetector(const SensorDetector&) = delete;
+        SensorDetector(SensorDetector&&) = delete;
+        SensorDetector& operator=(const SensorDetector&) = delete;
+        SensorDetector& operator=(SensorDetector&&) = delete;
+
+        // probe a bus and return the driver for what is on it, after its begin().
+        // Returns the null sensor if nothing identified itself, or if the slot is out of range.
+        MagnetoSensor* detect(byte slot, TwoWire* wire);
+
+        // probe several buses in one pass: slot i gets wires[i], and sensors[i] its driver.
+        // Returns the number of real sensors found.
+        byte detect(TwoWire* const* wires, byte count, MagnetoSensor** sensors);
+
+        // nullptr if the slot doesn't hold that type
+        MagnetoSensorHmc* getHmc(byte slot) const;
+        MagnetoSensorQmc* getQmc(byte slot) const;
+
+        MagnetoSensor* getSensor(byte slot);
+        SensorType getType(byte slot) const;
+
+    private:
+        static constexpr size_t DriverSize = sizeof(MagnetoSensorHmc) > sizeof(MagnetoSensorQmc)
+            ? sizeof(MagnetoSensorHmc) : sizeof(MagnetoSensorQmc);
+        static constexpr size_t DriverAlignment = alignof(MagnetoSensorHmc) > alignof(MagnetoSensorQmc)
+            ? alignof(MagnetoSensorHmc) : alignof(MagnetoSensorQmc);
+
+        struct Slot {
+            typename std::aligned_storage<DriverSize, DriverAlignment>::type storage;
+            MagnetoSensor* sensor;
+            SensorType type;
+        };
+
+        void clear(byte slot);
+
+        template <class Driver>
+        bool tryDriver(byte slot, TwoWire* wire, SensorType type);
+
+        Slot _slots[MaxBuses] {};
+        MagnetoSensorNull _null;
+    };
+}
+#endif
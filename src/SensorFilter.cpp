@@ -0,0 +1,123 @@
+// Copyright 2024 Rik Essenius
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+// except in compliance with the License. You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and limitations under the License.
+
+#include "SensorFilter.h"
+#include <cmath>
+
+namespace MagnetoSensors {
+    namespace {
+        constexpr double Pi = 3.14159265358979;
+
+        // shift right with rounding to nearest
+        int64_t roundShift(const int64_t value, const int bits) {
+            return (value + (static_cast<int64_t>(1) << (bits - 1))) >> bits;
+        }
+
+        // SHRT_MIN means saturated, so a filter never returns it
+        short clampToShort(const int64_t value) {
+            if (value > SHRT_MAX) return SHRT_MAX;
+            if (value < -SHRT_MAX) return -SHRT_MAX;
+            return static_cast<short>(value);
+        }
+    }
+
+    constexpr int LowPassFilter::CoefficientBits;
+    constexpr int LowPassFilter::StateBits;
+    constexpr int DcBlocker::CoefficientBits;
+    constexpr int DcBlocker::StateBits;
+
+    SensorData LowPassFilter::apply(const SensorData& sample) {
+        return { applyAxis(sample.x, _state[0]), applyAxis(sample.y, _state[1]), applyAxis(sample.z, _state[2]) };
+    }
+
+    void LowPassFilter::apply(SensorData* samples, const size_t count) {
+        for (size_t i = 0; i < count; i++) samples[i] = apply(samples[i]);
+    }
+
+    short LowPassFilter::applyAxis(const short value, AxisState& state) const {
+        if (value == SHRT_MIN) return value;
+        if (!state.isPrimed) {
+            // start as if the input had been constant, so there is no step from 0 to the field
+            state.x1 = state.x2 = value;
+            state.y1 = state.y2 = value * (1 << StateBits);
+            state.isPrimed = true;
+        }
+        // direct form I: the input history is in counts, the output history has StateBits fraction bits
+        const int64_t feedForward = static_cast<int64_t>(_b0) * value +
+            static_cast<int64_t>(_b1) * state.x1 +
+            static_cast<int64_t>(_b2) * state.x2;
+        const int64_t feedBack = static_cast<int64_t>(_a1) * state.y1 + static_cast<int64_t>(_a2) * state.y2;
+        const auto output = static_cast<int32_t>(roundShift(feedForward * (1 << StateBits) - feedBack, CoefficientBits));
+        state.x2 = state.x1;
+        state.x1 = value;
+        state.y2 = state.y1;
+        state.y1 = output;
+        return clampToShort(roundShift(output, StateBits));
+    }
+
+    void LowPassFilter::configure(const double cutoffHz, const double sampleRateHz, const double q) {
+        // the low-pass biquad from the Audio EQ Cookbook (R. Bristow-Johnson), normalized to a0 = 1
+        const double omega = 2 * Pi * cutoffHz / sampleRateHz;
+        const double alpha = std::sin(omega) / (2 * q);
+        const double a0 = 1 + alpha;
+        constexpr double One = 1L << CoefficientBits;
+        _a1 = static_cast<int32_t>(std::lround(-2 * std::cos(omega) / a0 * One));
+        _a2 = static_cast<int32_t>(std::lround((1 - alpha) / a0 * One));
+        // b0 + b1 + b2 = 1 + a1 + a2, and b0:b1:b2 = 1:2:1. Deriving them from the rounded a's keeps the DC gain at
+        // exactly 1, which matters at low cutoff frequencies where 1 + a1 + a2 is small.
+        const int32_t dcSum = (1L << CoefficientBits) + _a1 + _a2;
+        _b0 = dcSum / 4;
+        _b2 = _b0;
+        _b1 = dcSum - 2 * _b0;
+        reset();
+    }
+
+    void LowPassFilter::reset() {
+        for (auto& state : _state) state = AxisState();
+    }
+
+    SensorData DcBlocker::apply(const SensorData& sample) {
+        return { applyAxis(sample.x, _state[0]), applyAxis(sample.y, _state[1]), applyAxis(sample.z, _state[2]) };
+    }
+
+    void DcBlocker::apply(SensorData* samples, const size_t count) {
+        for (size_t i = 0; i < count; i++) samples[i] = apply(samples[i]);
+    }
+
+    short DcBlocker::applyAxis(const short value, AxisState& state) const {
+        if (value == SHRT_MIN) return value;
+        if (!state.isPrimed) {
+            // assume the first value was there all along, i.e. it is all DC
+            state.previousInput = value;
+            state.previousOutput = 0;
+            state.isPrimed = true;
+        }
+        // y[n] = x[n] - x[n-1] + pole * y[n-1], with the output history having StateBits fraction bits
+        const int64_t feedBack = roundShift(static_cast<int64_t>(_pole) * state.previousOutput, CoefficientBits);
+        const auto output = static_cast<int32_t>((value - state.previousInput) * (1 << StateBits) + feedBack);
+        state.previousInput = value;
+        state.previousOutput = output;
+        return clampToShort(roundShift(output, StateBits));
+    }
+
+    void DcBlocker::configure(const double cutoffHz, const double sampleRateHz) {
+        constexpr double One = 1L << CoefficientBits;
+        double pole = 1 - 2 * Pi * cutoffHz / sampleRateHz;
+        if (pole < 0) pole = 0;
+        _pole = static_cast<int32_t>(std::lround(pole * One));
+        if (_pole >= 1L << CoefficientBits) _pole = (1L << CoefficientBits) - 1;
+        reset();
+    }
+
+    void DcBlocker::reset() {
+        for (auto& state : _state) state = AxisState();
+    }
+}
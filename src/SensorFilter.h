@@ -0,0 +1,134 @@
+// Copyright 2024 Rik Essenius
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+// except in compliance with the License. You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and limitations under the License.
+
+// Filters for streams of samples, per axis, in integer arithmetic and without allocations:
+// - LowPassFilter: second order (biquad) Butterworth low-pass
+// - MovingAverage: average of the last Length samples, with a running sum so the cost doesn't depend on Length
+// - DcBlocker: first order high-pass that removes the constant part of the field (e.g. the earth's field)
+//
+// Each has apply() for a single sample and for a block of samples (in place), and reset() to forget the history.
+// Chain them by applying one after the other. Configuration uses doubles, filtering does not.
+// Get the sample rate from MagnetoSensorQmc::getSampleRate or MagnetoSensorHmc::getSampleRate.
+//
+// A saturated axis (SHRT_MIN) passes through as is and doesn't change the filter state for that axis.
+
+#ifndef HEADER_SENSOR_FILTER
+#define HEADER_SENSOR_FILTER
+
+#include "SensorData.h"
+
+namespace MagnetoSensors {
+    class LowPassFilter {
+    public:
+        // coefficients are fixed point with this many fraction bits
+        static constexpr int CoefficientBits = 28;
+
+        // q = 1/sqrt(2) gives a Butterworth response. The cutoff must be below half the sample rate.
+        void configure(double cutoffHz, double sampleRateHz, double q = 0.70710678);
+
+        SensorData apply(const SensorData& sample);
+        void apply(SensorData* samples, size_t count);
+        void reset();
+
+    private:
+        // the output history keeps StateBits fraction bits, to limit rounding errors at low cutoff frequencies
+        static constexpr int StateBits = 8;
+
+        struct AxisState {
+            int32_t x1;
+            int32_t x2;
+            int32_t y1;
+            int32_t y2;
+            bool isPrimed;
+        };
+
+        short applyAxis(short value, AxisState& state) const;
+
+        int32_t _b0 = 1L << CoefficientBits;
+        int32_t _b1 = 0;
+        int32_t _b2 = 0;
+        int32_t _a1 = 0;
+        int32_t _a2 = 0;
+        AxisState _state[3] {};
+    };
+
+    class DcBlocker {
+    public:
+        // frequencies well below the cutoff get removed
+        void configure(double cutoffHz, double sampleRateHz);
+
+        SensorData apply(const SensorData& sample);
+        void apply(SensorData* samples, size_t count);
+        void reset();
+
+    private:
+        static constexpr int CoefficientBits = 15;
+        static constexpr int StateBits = 8;
+
+        struct AxisState {
+            int32_t previousInput;
+            int32_t previousOutput;
+            bool isPrimed;
+        };
+
+        short applyAxis(short value, AxisState& state) const;
+
+        int32_t _pole = 0;
+        AxisState _state[3] {};
+    };
+
+    template <size_t Length>
+    class MovingAverage {
+        static_assert(Length > 0 && Length <= 65536, "Length must be between 1 and 65536 (so the sums fit 32 bits)");
+
+    public:
+        SensorData apply(const SensorData& sample) {
+            return { applyAxis(sample.x, 0), applyAxis(sample.y, 1), applyAxis(sample.z, 2) };
+        }
+
+        void apply(SensorData* samples, const size_t count) {
+            for (size_t i = 0; i < count; i++) samples[i] = apply(samples[i]);
+        }
+
+        // until Length samples came in, the average is over the samples so far
+        void reset() {
+            for (auto& axis : _axes) axis = Axis();
+        }
+
+    private:
+        struct Axis {
+            short values[Length] {};
+            int32_t sum = 0;
+            size_t next = 0;
+            size_t count = 0;
+        };
+
+        short applyAxis(const short value, const int index) {
+            if (value == SHRT_MIN) return value;
+            Axis& axis = _axes[index];
+            axis.sum += value - axis.values[axis.next];
+            axis.values[axis.next] = value;
+            axis.next = axis.next + 1 == Length ? 0 : axis.next + 1;
+            if (axis.count == Length) return divide(axis.sum, static_cast<int32_t>(Length));
+            axis.count++;
+            return divide(axis.sum, static_cast<int32_t>(axis.count));
+        }
+
+        // round to nearest, also for negative sums. With a constant divisor, the compiler avoids the division.
+        static short divide(const int32_t sum, const int32_t count) {
+            const int32_t half = count / 2;
+            return static_cast<short>(sum >= 0 ? (sum + half) / count : (sum - half) / count);
+        }
+
+        Axis _axes[3];
+    };
+}
+#endif
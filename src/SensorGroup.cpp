@@ -0,0 +1,92 @@
+// Copyright 2024 Rik Essenius
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+// except in compliance with the License. You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and limitations under the License.
+
+#include "SensorGroup.h"
+
+namespace MagnetoSensors {
+    constexpr byte SensorGroup::MaxSensors;
+    constexpr byte SensorGroup::MaxBuses;
+
+    bool SensorGroup::add(MagnetoSensor* sensor) {
+        if (_sensorCount == MaxSensors) return false;
+        TwoWire* wire = sensor->getWire();
+        byte bus = 0;
+        while (bus < _busCount && _buses[bus].wire != wire) bus++;
+        if (bus == _busCount) {
+            if (_busCount == MaxBuses) return false;
+            _buses[_busCount++] = { wire, 0, 0 };
+        }
+        _members[_sensorCount++] = { sensor, bus };
+        return true;
+    }
+
+    void SensorGroup::begin() {
+        for (byte i = 0; i < _sensorCount; i++) _members[i].sensor->startSample();
+        _next = 0;
+        resetStatistics();
+    }
+
+    byte SensorGroup::getBus(const byte sensor) const {
+        return _members[sensor].bus;
+    }
+
+    byte SensorGroup::getBusCount() const {
+        return _busCount;
+    }
+
+    unsigned long SensorGroup::getMisses(const byte bus) const {
+        return _buses[bus].misses;
+    }
+
+    unsigned long SensorGroup::getSamples(const byte bus) const {
+        return _buses[bus].samples;
+    }
+
+    double SensorGroup::getSamplesPerSecond(const byte bus) const {
+        constexpr double MicrosPerSecond = 1e6;
+        const unsigned long elapsed = micros() - _startMicros;
+        if (elapsed == 0) return 0.0;
+        return _buses[bus].samples * MicrosPerSecond / elapsed;
+    }
+
+    byte SensorGroup::getSensorCount() const {
+        return _sensorCount;
+    }
+
+    size_t SensorGroup::poll(GroupSample* samples, const size_t maxCount) {
+        size_t count = 0;
+        for (byte visited = 0; visited < _sensorCount && count < maxCount; visited++) {
+            const byte index = _next;
+            _next = _next + 1 == _sensorCount ? 0 : _next + 1;
+            const Member& member = _members[index];
+            SensorData data{};
+            if (!member.sensor->tryCollect(data)) {
+                _buses[member.bus].misses++;
+                continue;
+            }
+            // the sample is from now, not from after starting the next conversion (which takes a bus transaction)
+            const unsigned long timestamp = micros();
+            // start the next conversion before anything else, so it runs while we poll the others
+            member.sensor->startSample();
+            samples[count++] = { data, timestamp, index };
+            _buses[member.bus].samples++;
+        }
+        return count;
+    }
+
+    void SensorGroup::resetStatistics() {
+        for (byte bus = 0; bus < _busCount; bus++) {
+            _buses[bus].samples = 0;
+            _buses[bus].misses = 0;
+        }
+        _startMicros = micros();
+    }
+}
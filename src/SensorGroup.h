@@ -0,0 +1,90 @@
+// Copyright 2024 Rik Essenius
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+// except in compliance with the License. You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and limitations under the License.
+
+// Samples several sensors, on one or more buses, with their conversions overlapping.
+//
+// A sensor only needs the bus to start a measurement and to collect the result; the conversion itself takes
+// milliseconds. So the group starts a measurement on every sensor, and then polls them round robin. A sensor
+// that has a result gets collected and started again right away, while the others keep converting.
+// For HMC sensors in single mode that is startSample/tryCollect; QMC sensors measure continuously,
+// and collecting only succeeds once they report data ready.
+//
+// poll() visits every sensor at most once and never waits, so call it from the sampling loop. Don't read the
+// sensors in the group by other means, or the group and the caller will compete for the results.
+// The group counts the samples per bus, to show how many sensor samples per second each bus sustains.
+
+#ifndef HEADER_SENSOR_GROUP
+#define HEADER_SENSOR_GROUP
+
+#include "MagnetoSensor.h"
+
+namespace MagnetoSensors {
+    struct GroupSample {
+        SensorData data;
+        unsigned long timestamp;
+        // the index of the sensor in the group, in the order they were added
+        byte sensor;
+    };
+
+    class SensorGroup {
+    public:
+        static constexpr byte MaxSensors = 8;
+        // the ESP32 has two I2C controllers
+        static constexpr byte MaxBuses = 2;
+
+        // add a sensor that already had its begin(). Returns false if the group is full, or the sensor is on a
+        // new bus while there are already MaxBuses.
+        bool add(MagnetoSensor* sensor);
+
+        // start a measurement on all sensors, and start counting
+        void begin();
+
+        // the index of the bus a sensor is on, in the order the buses were first seen
+        byte getBus(byte sensor) const;
+        byte getBusCount() const;
+
+        // the number of times a poll found a sensor on the bus without a result
+        unsigned long getMisses(byte bus) const;
+
+        unsigned long getSamples(byte bus) const;
+
+        // the sensor samples per second collected on the bus since begin() or resetStatistics()
+        double getSamplesPerSecond(byte bus) const;
+
+        byte getSensorCount() const;
+
+        // visit each sensor once, starting after the one visited last, until maxCount samples were collected.
+        // Returns the number of samples.
+        size_t poll(GroupSample* samples, size_t maxCount);
+
+        void resetStatistics();
+
+    private:
+        struct Member {
+            MagnetoSensor* sensor;
+            byte bus;
+        };
+
+        struct Bus {
+            TwoWire* wire;
+            unsigned long samples;
+            unsigned long misses;
+        };
+
+        Member _members[MaxSensors] {};
+        Bus _buses[MaxBuses] {};
+        byte _sensorCount = 0;
+        byte _busCount = 0;
+        byte _next = 0;
+        unsigned long _startMicros = 0;
+    };
+}
+#endif
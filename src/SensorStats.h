@@ -0,0 +1,173 @@
+// Copyright 2024 Rik Essenius
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+// except in compliance with the License. You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and limitations under the License.
+
+// Counters for what happens in the sensor hot paths, and a histogram of read latencies.
+// Only collected if MAGNETOSENSOR_STATS is defined (for the library and its users alike).
+// If not, SensorStats is an empty class whose methods do nothing, so the compiler removes the calls.
+
+#ifndef HEADER_SENSOR_STATS
+#define HEADER_SENSOR_STATS
+
+#include <ESP.h>
+#include "SensorData.h"
+
+namespace MagnetoSensors {
+
+    // Bucket 0 counts 0 us, bucket n counts [2^(n-1), 2^n) us. The last bucket also gets everything longer.
+    class LatencyHistogram {
+    public:
+        static constexpr int BucketCount = 16;
+
+        void add(const unsigned long latencyMicros) {
+            int bucket = 0;
+            for (unsigned long remaining = latencyMicros; remaining != 0 && bucket < BucketCount - 1; remaining >>= 1) {
+                bucket++;
+            }
+            _buckets[bucket]++;
+        }
+
+        unsigned long getCount(const int bucket) const {
+            return _buckets[bucket];
+        }
+
+        // the lowest latency that no longer fits in the bucket
+        static unsigned long getBucketLimit(const int bucket) {
+            return 1UL << bucket;
+        }
+
+        // the limit of the bucket in which the given percentage of the latencies fall
+        unsigned long getPercentile(const int percent) const {
+            const unsigned long total = getTotal();
+            if (total == 0) return 0;
+            unsigned long seen = 0;
+            for (int bucket = 0; bucket < BucketCount; bucket++) {
+                seen += _buckets[bucket];
+                if (seen * 100 >= total * percent) return getBucketLimit(bucket);
+            }
+            return getBucketLimit(BucketCount - 1);
+        }
+
+        unsigned long getTotal() const {
+            unsigned long total = 0;
+            for (const auto count : _buckets) total += count;
+            return total;
+        }
+
+        void reset() {
+            for (auto& count : _buckets) count = 0;
+        }
+
+    private:
+        unsigned long _buckets[BucketCount] {};
+    };
+
+#ifdef MAGNETOSENSOR_STATS
+
+    class SensorStats {
+    public:
+        static constexpr bool Enabled = true;
+        // endTransmission returns 0 for success and 1-5 for errors; 2 and 3 are NACKs
+        static constexpr byte ErrorCodeCount = 6;
+
+        unsigned long start() const { return micros(); }
+
+        void recordFailure() {
+            _reads++;
+            _failures++;
+        }
+
+        void recordRangeDecrease() { _rangeDecreases++; }
+
+        void recordRangeIncrease() { _rangeIncreases++; }
+
+        void recordRead(const SensorData& sample, const unsigned long startMicros) {
+            _reads++;
+            if (sample.isSaturated()) _saturations++;
+            _latency.add(micros() - startMicros);
+        }
+
+        void recordSoftReset() { _softResets++; }
+
+        void recordStale() {
+            _reads++;
+            _stale++;
+        }
+
+        void recordTimeout() { _timeouts++; }
+
+        void recordTransmission(const byte result) {
+            if (result != 0 && result < ErrorCodeCount) _transmissionErrors[result]++;
+        }
+
+        unsigned long getFailures() const { return _failures; }
+        const LatencyHistogram& getLatency() const { return _latency; }
+        unsigned long getNacks() const { return _transmissionErrors[2] + _transmissionErrors[3]; }
+        unsigned long getRangeDecreases() const { return _rangeDecreases; }
+        unsigned long getRangeIncreases() const { return _rangeIncreases; }
+        unsigned long getReads() const { return _reads; }
+        unsigned long getSaturations() const { return _saturations; }
+        unsigned long getSoftResets() const { return _softResets; }
+        unsigned long getStale() const { return _stale; }
+        unsigned long getTimeouts() const { return _timeouts; }
+        unsigned long getTransmissionErrors(const byte code) const { return code < ErrorCodeCount ? _transmissionErrors[code] : 0; }
+
+        void reset() { *this = SensorStats(); }
+
+    private:
+        unsigned long _reads = 0;
+        unsigned long _failures = 0;
+        unsigned long _stale = 0;
+        unsigned long _timeouts = 0;
+        unsigned long _saturations = 0;
+        unsigned long _rangeIncreases = 0;
+        unsigned long _rangeDecreases = 0;
+        unsigned long _softResets = 0;
+        unsigned long _transmissionErrors[ErrorCodeCount] {};
+        LatencyHistogram _latency;
+    };
+
+#else
+
+    class SensorStats {
+    public:
+        static constexpr bool Enabled = false;
+
+        unsigned long start() const { return 0; }
+        void recordFailure() {}
+        void recordRangeDecrease() {}
+        void recordRangeIncrease() {}
+        void recordRead(const SensorData&, unsigned long) {}
+        void recordSoftReset() {}
+        void recordStale() {}
+        void recordTimeout() {}
+        void recordTransmission(byte) {}
+
+        unsigned long getFailures() const { return 0; }
+        const LatencyHistogram& getLatency() const {
+            static const LatencyHistogram Empty;
+            return Empty;
+        }
+        unsigned long getNacks() const { return 0; }
+        unsigned long getRangeDecreases() const { return 0; }
+        unsigned long getRangeIncreases() const { return 0; }
+        unsigned long getReads() const { return 0; }
+        unsigned long getSaturations() const { return 0; }
+        unsigned long getSoftResets() const { return 0; }
+        unsigned long getStale() const { return 0; }
+        unsigned long getTimeouts() const { return 0; }
+        unsigned long getTransmissionErrors(byte) const { return 0; }
+
+        void reset() {}
+    };
+
+#endif
+}
+#endif
@@ -0,0 +1,165 @@
+// Copyright 2024 Rik Essenius
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+// except in compliance with the License. You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and limitations under the License.
+
+#include "SensorWatchdog.h"
+
+namespace MagnetoSensors {
+    constexpr byte SensorWatchdog::NoPowerPin;
+    constexpr unsigned long SensorWatchdog::DefaultTimeoutMicros;
+    constexpr unsigned int SensorWatchdog::DefaultRepeatLimit;
+    constexpr unsigned int SensorWatchdog::DefaultSaturationLimit;
+    constexpr unsigned long SensorWatchdog::DefaultPowerOffTimeoutMicros;
+    constexpr unsigned long SensorWatchdog::DefaultSettleMicros;
+    constexpr unsigned long SensorWatchdog::DefaultPowerOnTimeoutMicros;
+
+    SensorWatchdog::SensorWatchdog(MagnetoSensor* sensor, const byte powerPin) : _sensor(sensor), _powerPin(powerPin) {}
+
+    void SensorWatchdog::begin() {
+        if (_powerPin != NoPowerPin) pinMode(_powerPin, OUTPUT);
+        setPower(true);
+        _state = WatchdogHealthy;
+        _repeats = 0;
+        _saturations = 0;
+        _lastSuccess = micros();
+    }
+
+    bool SensorWatchdog::check(const bool success, const SensorData& sample) {
+        if (_state != WatchdogHealthy) return false;
+        const unsigned long now = micros();
+        if (!success) {
+            if (_timeoutMicros != 0 && now - _lastSuccess > _timeoutMicros) startRecovery(FaultTimeout);
+            return isHealthy();
+        }
+        _lastSuccess = now;
+        _repeats = sample == _previous ? _repeats + 1 : 0;
+        _previous = sample;
+        _saturations = sample.isSaturated() ? _saturations + 1 : 0;
+        if (_repeatLimit != 0 && _repeats > _repeatLimit) {
+            startRecovery(FaultRepeated);
+        } else if (_saturationLimit != 0 && _saturations > _saturationLimit) {
+            startRecovery(FaultSaturated);
+        }
+        return isHealthy();
+    }
+
+    void SensorWatchdog::configureLimits(
+        const unsigned long timeoutMicros,
+        const unsigned int repeatLimit,
+        const unsigned int saturationLimit) {
+        _timeoutMicros = timeoutMicros;
+        _repeatLimit = repeatLimit;
+        _saturationLimit = saturationLimit;
+    }
+
+    void SensorWatchdog::configureTiming(
+        const unsigned long powerOffTimeoutMicros,
+        const unsigned long settleMicros,
+        const unsigned long powerOnTimeoutMicros) {
+        _powerOffTimeoutMicros = powerOffTimeoutMicros;
+        _settleMicros = settleMicros;
+        _powerOnTimeoutMicros = powerOnTimeoutMicros;
+    }
+
+    void SensorWatchdog::enter(const WatchdogState state, const unsigned long timestamp) {
+        _state = state;
+        _stateStart = timestamp;
+    }
+
+    unsigned long SensorWatchdog::getFailedAttempts() const {
+        return _failedAttempts;
+    }
+
+    WatchdogFault SensorWatchdog::getLastFault() const {
+        return _lastFault;
+    }
+
+    unsigned long SensorWatchdog::getLastRecoveryMicros() const {
+        return _lastRecoveryMicros;
+    }
+
+    unsigned long SensorWatchdog::getRecoveries() const {
+        return _recoveries;
+    }
+
+    WatchdogState SensorWatchdog::getState() const {
+        return _state;
+    }
+
+    unsigned long SensorWatchdog::getTotalRecoveryMicros() const {
+        return _totalRecoveryMicros;
+    }
+
+    bool SensorWatchdog::isHealthy() const {
+        return _state == WatchdogHealthy;
+    }
+
+    void SensorWatchdog::recover() {
+        if (_state == WatchdogHealthy) startRecovery(FaultNone);
+    }
+
+    void SensorWatchdog::setPower(const bool on) const {
+        if (_powerPin != NoPowerPin) digitalWrite(_powerPin, on ? HIGH : LOW);
+    }
+
+    void SensorWatchdog::startCycle(const unsigned long timestamp) {
+        // without a power pin there is nothing to switch, so go straight to restarting the sensor
+        if (_powerPin == NoPowerPin) {
+            enter(WatchdogPoweringOn, timestamp);
+            return;
+        }
+        setPower(false);
+        enter(WatchdogPoweringOff, timestamp);
+    }
+
+    void SensorWatchdog::startRecovery(const WatchdogFault fault) {
+        _lastFault = fault;
+        _recoveryStart = micros();
+        startCycle(_recoveryStart);
+    }
+
+    bool SensorWatchdog::update() {
+        const unsigned long now = micros();
+        const unsigned long elapsed = now - _stateStart;
+        switch (_state) {
+        case WatchdogPoweringOff:
+            // one ping per call. If the sensor keeps answering (e.g. the pin isn't wired), carry on after the deadline.
+            if (elapsed <= _powerOffTimeoutMicros && _sensor->isOn()) return false;
+            enter(WatchdogPoweredOff, now);
+            return false;
+        case WatchdogPoweredOff:
+            if (elapsed < _settleMicros) return false;
+            setPower(true);
+            enter(WatchdogPoweringOn, now);
+            return false;
+        case WatchdogPoweringOn:
+            if (_sensor->isOn()) {
+                if (_sensor->begin() && _sensor->handlePowerOn()) {
+                    const unsigned long end = micros();
+                    _lastRecoveryMicros = end - _recoveryStart;
+                    _totalRecoveryMicros += _lastRecoveryMicros;
+                    _recoveries++;
+                    _repeats = 0;
+                    _saturations = 0;
+                    _lastSuccess = end;
+                    enter(WatchdogHealthy, end);
+                    return true;
+                }
+            } else if (elapsed <= _powerOnTimeoutMicros) {
+                return false;
+            }
+            _failedAttempts++;
+            startCycle(micros());
+            return false;
+        default:
+            return true;
+        }
+    }
+}
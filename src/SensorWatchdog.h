@@ -0,0 +1,120 @@
+// Copyright 2024 Rik Essenius
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+// except in compliance with the License. You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and limitations under the License.
+
+// Watches a sensor and power cycles it when it gets stuck. These sensors sometimes stop responding,
+// and then only cutting the power helps, so the sensor should get its power from a GPIO pin.
+//
+// Pass the outcome of every read to check(). The sensor counts as stuck if no read succeeded for a while,
+// if it keeps returning exactly the same sample (real sensors always have some noise), or if every sample
+// is saturated. Then the watchdog brings the power pin down, waits until the sensor stops answering
+// (or a deadline passes), lets it settle, brings the power back up, waits until the sensor answers again,
+// and calls begin() and handlePowerOn(). If the sensor doesn't come back before the deadline, it starts over.
+//
+// None of this waits: update() does one step at a time, so call it from the loop, and skip reading while it
+// returns false. Without a power pin, recovery just calls begin() and handlePowerOn() again.
+// Note that handlePowerOn() runs the HMC self test, which blocks for about 30 ms unless fast boot is on.
+
+#ifndef HEADER_SENSOR_WATCHDOG
+#define HEADER_SENSOR_WATCHDOG
+
+#include "MagnetoSensor.h"
+
+namespace MagnetoSensors {
+    enum WatchdogFault : byte {
+        FaultNone = 0,
+        FaultTimeout = 1,
+        FaultRepeated = 2,
+        FaultSaturated = 3
+    };
+
+    enum WatchdogState : byte {
+        WatchdogHealthy = 0,
+        WatchdogPoweringOff = 1,
+        WatchdogPoweredOff = 2,
+        WatchdogPoweringOn = 3
+    };
+
+    class SensorWatchdog {
+    public:
+        static constexpr byte NoPowerPin = 0xFF;
+
+        explicit SensorWatchdog(MagnetoSensor* sensor, byte powerPin = NoPowerPin);
+
+        // switch the power pin to output and power the sensor. Call before the sensor's begin().
+        void begin();
+
+        // pass the result of each read. Returns whether the sensor is healthy.
+        bool check(bool success, const SensorData& sample);
+
+        // when the sensor counts as stuck: no successful read for timeoutMicros, or more than the number of
+        // identical or saturated samples in a row. A limit of 0 switches that check off.
+        void configureLimits(unsigned long timeoutMicros, unsigned int repeatLimit = DefaultRepeatLimit,
+                             unsigned int saturationLimit = DefaultSaturationLimit);
+
+        // the deadlines for the sensor to stop answering after power off and to answer again after power on,
+        // and how long the power stays off after the sensor stopped answering
+        void configureTiming(unsigned long powerOffTimeoutMicros, unsigned long settleMicros,
+                             unsigned long powerOnTimeoutMicros);
+
+        // power cycles that didn't bring the sensor back before the deadline
+        unsigned long getFailedAttempts() const;
+        WatchdogFault getLastFault() const;
+        unsigned long getLastRecoveryMicros() const;
+        unsigned long getRecoveries() const;
+        WatchdogState getState() const;
+        unsigned long getTotalRecoveryMicros() const;
+
+        bool isHealthy() const;
+
+        // start a recovery now, e.g. when the application found a problem itself
+        void recover();
+
+        // do the next step of a recovery, if one is running. Returns whether the sensor is healthy.
+        bool update();
+
+        static constexpr unsigned long DefaultTimeoutMicros = 500000;
+        static constexpr unsigned int DefaultRepeatLimit = 50;
+        static constexpr unsigned int DefaultSaturationLimit = 100;
+        static constexpr unsigned long DefaultPowerOffTimeoutMicros = 50000;
+        static constexpr unsigned long DefaultSettleMicros = 10000;
+        static constexpr unsigned long DefaultPowerOnTimeoutMicros = 50000;
+
+    private:
+        void enter(WatchdogState state, unsigned long timestamp);
+        void setPower(bool on) const;
+        void startCycle(unsigned long timestamp);
+        void startRecovery(WatchdogFault fault);
+
+        MagnetoSensor* _sensor;
+        byte _powerPin;
+        unsigned long _timeoutMicros = DefaultTimeoutMicros;
+        unsigned int _repeatLimit = DefaultRepeatLimit;
+        unsigned int _saturationLimit = DefaultSaturationLimit;
+        unsigned long _powerOffTimeoutMicros = DefaultPowerOffTimeoutMicros;
+        unsigned long _settleMicros = DefaultSettleMicros;
+        unsigned long _powerOnTimeoutMicros = DefaultPowerOnTimeoutMicros;
+
+        WatchdogState _state = WatchdogHealthy;
+        WatchdogFault _lastFault = FaultNone;
+        SensorData _previous{};
+        unsigned int _repeats = 0;
+        unsigned int _saturations = 0;
+        unsigned long _lastSuccess = 0;
+        unsigned long _stateStart = 0;
+        unsigned long _recoveryStart = 0;
+
+        unsigned long _recoveries = 0;
+        unsigned long _failedAttempts = 0;
+        unsigned long _lastRecoveryMicros = 0;
+        unsigned long _totalRecoveryMicros = 0;
+    };
+}
+#endif
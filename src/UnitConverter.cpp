@@ -0,0 +1,105 @@
+// Copyright 2024 Rik Essenius
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+// except in compliance with the License. You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and limitations under the License.
+
+#include "UnitConverter.h"
+
+namespace MagnetoSensors {
+    // we treat the samples as one array of x, y, z values
+    static_assert(sizeof(SensorData) == 3 * sizeof(short), "SensorData has no padding");
+
+    namespace {
+        constexpr double MicroTeslaPerGauss = 100.0;
+        constexpr double NanoTeslaPerGauss = 100000.0;
+        constexpr float NanoTeslaPerMicroTesla = 1000.0f;
+        // the factor must fit 15 bits, so that multiplying it with a 16 bit count fits 32 bits
+        constexpr double FactorLimit = 32768.0;
+        constexpr byte MaxShift = 30;
+
+        // the largest shift that keeps the factor within the limit
+        constexpr byte fixedShift(const double nanoTeslaPerCount, const byte shift) {
+            return shift >= MaxShift || nanoTeslaPerCount * (1L << (shift + 1)) >= FactorLimit ?
+                shift : fixedShift(nanoTeslaPerCount, static_cast<byte>(shift + 1));
+        }
+
+        constexpr FixedScale fixedScale(const double nanoTeslaPerCount, const byte shift) {
+            return FixedScale{ static_cast<int32_t>(nanoTeslaPerCount * (1L << shift) + 0.5), shift };
+        }
+
+        constexpr FixedScale fixedScale(const double gain) {
+            return gain <= 0 ?
+                FixedScale{ 0, 0 } :
+                fixedScale(NanoTeslaPerGauss / gain, fixedShift(NanoTeslaPerGauss / gain, 0));
+        }
+
+        constexpr float microTeslaPerCount(const double gain) {
+            return gain <= 0 ? 0.0f : static_cast<float>(MicroTeslaPerGauss / gain);
+        }
+
+        const short* values(const SensorData* samples) {
+            return reinterpret_cast<const short*>(samples);
+        }
+    }
+
+    UnitConverter::UnitConverter(const double gain) : UnitConverter(fixedScale(gain), microTeslaPerCount(gain)) {}
+
+    constexpr UnitConverter UnitConverter::fromGain(const double gain) {
+        return UnitConverter(fixedScale(gain), microTeslaPerCount(gain));
+    }
+
+    const UnitConverter& UnitConverter::get(const HmcRange range) {
+        // all computed at compile time
+        static const UnitConverter Converters[] = {
+            fromGain(MagnetoSensorHmc::getGain(HmcRange0_88)), fromGain(MagnetoSensorHmc::getGain(HmcRange1_3)),
+            fromGain(MagnetoSensorHmc::getGain(HmcRange1_9)), fromGain(MagnetoSensorHmc::getGain(HmcRange2_5)),
+            fromGain(MagnetoSensorHmc::getGain(HmcRange4_0)), fromGain(MagnetoSensorHmc::getGain(HmcRange4_7)),
+            fromGain(MagnetoSensorHmc::getGain(HmcRange5_6)), fromGain(MagnetoSensorHmc::getGain(HmcRange8_1))
+        };
+        constexpr byte RangeShift = 5;
+        return Converters[range >> RangeShift];
+    }
+
+    const UnitConverter& UnitConverter::get(const QmcRange range) {
+        static const UnitConverter Converters[] = {
+            fromGain(MagnetoSensorQmc::getGain(QmcRange2G)), fromGain(MagnetoSensorQmc::getGain(QmcRange8G))
+        };
+        constexpr byte RangeShift = 4;
+        return Converters[range >> RangeShift];
+    }
+
+    void UnitConverter::toMicroTesla(const SensorData* samples, float* out, const size_t count) const {
+        const short* __restrict in = values(samples);
+        float* __restrict target = out;
+        const float scale = _microTeslaPerCount;
+        for (size_t i = 0; i < 3 * count; i++) {
+            target[i] = static_cast<float>(in[i]) * scale;
+        }
+    }
+
+    void UnitConverter::toNanoTesla(const SensorData* samples, float* out, const size_t count) const {
+        const short* __restrict in = values(samples);
+        float* __restrict target = out;
+        const float scale = _microTeslaPerCount * NanoTeslaPerMicroTesla;
+        for (size_t i = 0; i < 3 * count; i++) {
+            target[i] = static_cast<float>(in[i]) * scale;
+        }
+    }
+
+    void UnitConverter::toNanoTesla(const SensorData* samples, int32_t* out, const size_t count) const {
+        const short* __restrict in = values(samples);
+        int32_t* __restrict target = out;
+        const int32_t factor = _fixed.factor;
+        const byte shift = _fixed.shift;
+        for (size_t i = 0; i < 3 * count; i++) {
+            // arithmetic shift, so this rounds down
+            target[i] = (in[i] * factor) >> shift;
+        }
+    }
+}
@@ -0,0 +1,61 @@
+// Copyright 2024 Rik Essenius
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+// except in compliance with the License. You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and limitations under the License.
+
+// Converts batches of raw samples to physical units, without a division (or a double) per sample.
+// The ESP32 has no double precision FPU, so dividing by getGain() for every sample is expensive.
+//
+// The fixed point path returns integer nanoTesla. That is finer than one count in every range (at least 7 nT),
+// so we don't lose resolution. It multiplies by a reciprocal in Q format that fits 15 bits, so the product of that
+// and a 16 bit count fits 32 bits. The float path multiplies by a float reciprocal.
+// The loops are plain element-wise operations over the x, y, z values, so compilers can vectorize them.
+//
+// Saturated values (SHRT_MIN) get converted like any other value; check isSaturated() first if that matters.
+
+#ifndef HEADER_UNIT_CONVERTER
+#define HEADER_UNIT_CONVERTER
+
+#include "MagnetoSensorHmc.h"
+#include "MagnetoSensorQmc.h"
+
+namespace MagnetoSensors {
+    // nanoTesla = (count * factor) >> shift
+    struct FixedScale {
+        int32_t factor;
+        byte shift;
+    };
+
+    class UnitConverter {
+    public:
+        // gain in counts per Gauss, as returned by getGain()
+        explicit UnitConverter(double gain);
+
+        // precomputed for each range
+        static const UnitConverter& get(HmcRange range);
+        static const UnitConverter& get(QmcRange range);
+
+        FixedScale getFixedScale() const { return _fixed; }
+        float getMicroTeslaPerCount() const { return _microTeslaPerCount; }
+
+        // out gets x, y, z for each sample, so it needs room for 3 * count values
+        void toMicroTesla(const SensorData* samples, float* out, size_t count) const;
+        void toNanoTesla(const SensorData* samples, float* out, size_t count) const;
+        void toNanoTesla(const SensorData* samples, int32_t* out, size_t count) const;
+
+    private:
+        static constexpr UnitConverter fromGain(double gain);
+        constexpr UnitConverter(FixedScale fixed, float microTeslaPerCount) :
+            _fixed(fixed), _microTeslaPerCount(microTeslaPerCount) {}
+
+        FixedScale _fixed;
+        float _microTeslaPerCount;
+    };
+}
+#endif
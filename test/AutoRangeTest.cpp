@@ -0,0 +1,130 @@
+// Copyright 2024 Rik Essenius
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+// except in compliance with the License. You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and limitations under the License.
+
+#include "gtest/gtest.h"
+#include <AutoRange.h>
+#include <MagnetoSensorHmc.h>
+#include <MagnetoSensorNull.h>
+#include <MagnetoSensorQmc.h>
+#include "HmcSimulator.h"
+#include "QmcSimulator.h"
+
+namespace MagnetoSensorsTest {
+    using namespace MagnetoSensors;
+
+    namespace {
+        // read count samples and feed them to the controller. Returns the number of range changes.
+        int run(MagnetoSensor& sensor, AutoRange& autoRange, const int count, SensorData& sample) {
+            int changes = 0;
+            for (int i = 0; i < count; i++) {
+                EXPECT_EQ(1u, sensor.readBatch(&sample, 1)) << "Read sample " << i;
+                if (autoRange.update(sample)) changes++;
+            }
+            return changes;
+        }
+    }
+
+    TEST(AutoRangeTest, hmcAutoRangeTest) {
+        setRealTime(false);
+        HmcSimulator simulator;
+        simulator.setField(0.2, 0.1, -0.1);
+        MagnetoSensorHmc sensor(&simulator);
+        sensor.configureRange(HmcRange0_88);
+        sensor.begin();
+        AutoRange autoRange(&sensor);
+        autoRange.configureTiming(10, 2);
+        autoRange.begin();
+        SensorData sample{};
+        EXPECT_EQ(0, run(sensor, autoRange, 20, sample)) << "Nothing to do in the most sensitive range";
+
+        // 1781 counts in 0.88, above 80% of 2047, but not saturated yet
+        simulator.setField(1.3, 0, 0);
+        EXPECT_EQ(1, run(sensor, autoRange, 20, sample)) << "Switched up once";
+        EXPECT_EQ(HmcRange1_3, sensor.getRange()) << "Range went up one step";
+        EXPECT_EQ(1417, sample.x) << "Sample in the new range";
+
+        simulator.setField(0.2, 0, 0);
+        EXPECT_EQ(0, run(sensor, autoRange, 9, sample)) << "Holding";
+        EXPECT_EQ(1, run(sensor, autoRange, 1, sample)) << "Switched down after the hold time";
+        EXPECT_EQ(HmcRange0_88, sensor.getRange()) << "Back in the most sensitive range";
+
+        simulator.setField(1.3, 0, 0);
+        EXPECT_EQ(1, run(sensor, autoRange, 3, sample)) << "Switched up again";
+        EXPECT_EQ(20u, autoRange.getHoldSamples()) << "Hold time doubled because it went up soon after going down";
+        EXPECT_EQ(2u, autoRange.getIncreases()) << "Two increases";
+        EXPECT_EQ(1u, autoRange.getDecreases()) << "One decrease";
+
+        // saturation also goes up, and at the top there is nowhere to go
+        simulator.setField(8, 0, 0);
+        EXPECT_EQ(6, run(sensor, autoRange, 30, sample)) << "Went up to the widest range";
+        EXPECT_EQ(HmcRange8_1, sensor.getRange()) << "Widest range";
+    }
+
+    TEST(AutoRangeTest, qmcAutoRangeTest) {
+        setRealTime(false);
+        QmcSimulator simulator;
+        simulator.setField(0.5, 0.1, -0.1);
+        MagnetoSensorQmc sensor(&simulator);
+        sensor.configureRange(QmcRange2G);
+        sensor.begin();
+        AutoRange autoRange(&sensor);
+        autoRange.configureThresholds(75, 30);
+        autoRange.configureTiming(5, 1);
+        autoRange.begin();
+        SensorData sample{};
+        EXPECT_EQ(0, run(sensor, autoRange, 10, sample)) << "Field fits in 2G";
+
+        simulator.setField(2.2, 0, 0);
+        EXPECT_EQ(1, run(sensor, autoRange, 10, sample)) << "Switched up";
+        EXPECT_EQ(QmcRange8G, sensor.getRange()) << "8G";
+        EXPECT_EQ(6600, sample.x) << "Sample with the 8G gain";
+
+        // 0.7 G is 8400 in 2G: more than 30% of the 24000 count limit (0.6 G), so we stay in 8G
+        simulator.setField(0.7, 0, 0);
+        EXPECT_EQ(0, run(sensor, autoRange, 20, sample)) << "Not enough headroom for 2G";
+        simulator.setField(0.5, 0, 0);
+        EXPECT_EQ(1, run(sensor, autoRange, 20, sample)) << "Switched down";
+        EXPECT_EQ(QmcRange2G, sensor.getRange()) << "2G";
+        EXPECT_EQ(6000, sample.x) << "Sample with the 2G gain";
+    }
+
+    TEST(AutoRangeTest, qmcAutoRangeRisingTest) {
+        setRealTime(false);
+        QmcSimulator simulator;
+        MagnetoSensorQmc sensor(&simulator);
+        sensor.configureRange(QmcRange2G);
+        sensor.begin();
+        EXPECT_EQ(24000, sensor.getCountLimit()) << "Overflow at 2 G in 2G and 8 G in 8G";
+        AutoRange autoRange(&sensor);
+        autoRange.begin();
+        SensorData sample{};
+
+        // 80% of the limit is 1.6 G. The sensor overflows at 2 G, so it must switch well before that.
+        int changes = 0;
+        for (int step = 0; step <= 4; step++) {
+            simulator.setField(1.5 + 0.1 * step, 0, 0);
+            changes += run(sensor, autoRange, 5, sample);
+            EXPECT_FALSE(sample.isSaturated()) << "Not saturated at step " << step;
+        }
+        EXPECT_EQ(1, changes) << "Switched up once";
+        EXPECT_EQ(QmcRange8G, sensor.getRange()) << "8G";
+        EXPECT_EQ(5700, sample.x) << "1.9 G with the 8G gain";
+    }
+
+    TEST(AutoRangeTest, nullAutoRangeTest) {
+        MagnetoSensorNull sensor;
+        AutoRange autoRange(&sensor);
+        autoRange.begin();
+        const SensorData saturated{ SHRT_MIN, 0, 0 };
+        EXPECT_FALSE(autoRange.update(saturated)) << "Null sensor has no ranges";
+        EXPECT_EQ(0u, autoRange.getIncreases()) << "No increases";
+    }
+}
@@ -0,0 +1,180 @@
+// Copyright 2024 Rik Essenius
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+// except in compliance with the License. You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and limitations under the License.
+
+#include "gtest/gtest.h"
+#include <climits>
+#include <cmath>
+#include <vector>
+#include <Capture.h>
+#include <MagnetoSensorReplay.h>
+
+namespace MagnetoSensorsTest {
+    using MagnetoSensors::CaptureDelta;
+    using MagnetoSensors::CaptureReader;
+    using MagnetoSensors::CaptureWriter;
+    using MagnetoSensors::MagnetoSensorReplay;
+    using MagnetoSensors::ReplayHeader;
+    using MagnetoSensors::SensorData;
+
+    namespace {
+        // a slow rotation with a bit of noise, and an idle stretch in the middle
+        std::vector<SensorData> makeSamples(const size_t count) {
+            std::vector<SensorData> samples;
+            for (size_t i = 0; i < count; i++) {
+                const bool idle = i >= count / 2 && i < count / 2 + 150;
+                const double angle = idle ? 0 : static_cast<double>(i) / 100.0;
+                const auto noise = static_cast<short>(idle ? 0 : (i * 7) % 5 - 2);
+                samples.push_back({
+                    static_cast<short>(1000 * std::cos(angle) + noise),
+                    static_cast<short>(1000 * std::sin(angle) - noise),
+                    static_cast<short>(-300 + noise) });
+            }
+            return samples;
+        }
+
+        std::vector<byte> encode(const std::vector<SensorData>& samples, CaptureWriter& writer) {
+            std::vector<byte> capture;
+            unsigned long timestamp = 0;
+            for (const auto& sample : samples) {
+                if (writer.add(sample, timestamp)) {
+                    capture.insert(capture.end(), writer.getBlock(), writer.getBlock() + writer.getBlockSize());
+                }
+                timestamp += 10000;
+            }
+            if (writer.flush()) {
+                capture.insert(capture.end(), writer.getBlock(), writer.getBlock() + writer.getBlockSize());
+            }
+            return capture;
+        }
+    }
+
+    TEST(CaptureTest, captureRoundTripTest) {
+        const auto samples = makeSamples(1000);
+        CaptureWriter writer;
+        const auto capture = encode(samples, writer);
+        EXPECT_EQ(1000ul, writer.getSamples()) << "All samples written";
+        EXPECT_EQ(capture.size(), writer.getBytes()) << "Byte count ok";
+        EXPECT_LT(capture.size(), samples.size() * sizeof(SensorData) / 2) << "Less than half the raw size";
+        EXPECT_FALSE(writer.flush()) << "Nothing left to flush";
+
+        CaptureReader reader(capture.data(), capture.size());
+        EXPECT_EQ(1000ul, reader.countSamples()) << "Sample count from the block headers";
+        std::vector<SensorData> decoded(samples.size());
+        // uneven chunks, so we stop in the middle of blocks and runs
+        size_t done = 0;
+        size_t chunk = 1;
+        while (done < decoded.size()) {
+            const size_t got = reader.read(decoded.data() + done, chunk);
+            if (got == 0) break;
+            done += got;
+            chunk = chunk * 3 % 97 + 1;
+        }
+        EXPECT_EQ(samples.size(), done) << "All samples decoded";
+        EXPECT_FALSE(reader.hasError()) << "No errors";
+        for (size_t i = 0; i < samples.size(); i++) {
+            ASSERT_EQ(samples[i], decoded[i]) << "Sample " << i;
+        }
+        SensorData sample{};
+        EXPECT_EQ(0u, reader.read(&sample, 1)) << "End of capture";
+    }
+
+    TEST(CaptureTest, captureRunTest) {
+        const std::vector<SensorData> samples(300, SensorData{ 12, -34, 56 });
+        CaptureWriter writer;
+        const auto capture = encode(samples, writer);
+        // three blocks, each a header, a keyframe and a run
+        EXPECT_LT(capture.size(), 40u) << "Idle stretch takes hardly any space";
+        CaptureReader reader(capture.data(), capture.size());
+        std::vector<SensorData> decoded(samples.size());
+        EXPECT_EQ(samples.size(), reader.read(decoded.data(), decoded.size())) << "All samples decoded";
+        EXPECT_EQ(samples[299], decoded[299]) << "Last sample ok";
+    }
+
+    TEST(CaptureTest, captureExtremeTest) {
+        std::vector<SensorData> samples;
+        for (int i = 0; i < 200; i++) {
+            const short value = i % 2 == 0 ? SHRT_MIN : SHRT_MAX;
+            samples.push_back({ value, static_cast<short>(-value - 1), value });
+        }
+        CaptureWriter writer;
+        size_t largest = 0;
+        for (const auto& sample : samples) {
+            if (writer.add(sample)) largest = writer.getBlockSize();
+        }
+        EXPECT_LE(largest, CaptureWriter::MaxBlockSize) << "Worst case block fits";
+        writer.flush();
+        const auto capture = encode(samples, writer);
+        CaptureReader reader(capture.data(), capture.size());
+        std::vector<SensorData> decoded(samples.size());
+        EXPECT_EQ(samples.size(), reader.read(decoded.data(), decoded.size())) << "All samples decoded";
+        EXPECT_EQ(samples[101], decoded[101]) << "Largest differences survive";
+    }
+
+    TEST(CaptureTest, captureSeekTest) {
+        const auto samples = makeSamples(1000);
+        CaptureWriter writer;
+        const auto capture = encode(samples, writer);
+        CaptureReader reader(capture.data(), capture.size());
+        EXPECT_TRUE(reader.seek(700)) << "Seek in the middle";
+        EXPECT_EQ(700ul, reader.getPosition()) << "Position ok";
+        EXPECT_EQ(640ul * 10000, reader.getBlockTimestamp()) << "Timestamp of the block";
+        SensorData sample{};
+        EXPECT_EQ(1u, reader.read(&sample, 1)) << "Read after seek";
+        EXPECT_EQ(samples[700], sample) << "Right sample after seek";
+        EXPECT_TRUE(reader.seek(0)) << "Seek back to the start";
+        EXPECT_EQ(1u, reader.read(&sample, 1)) << "Read at start";
+        EXPECT_EQ(samples[0], sample) << "First sample";
+        EXPECT_FALSE(reader.seek(1000)) << "Can't seek beyond the end";
+    }
+
+    TEST(CaptureTest, captureCorruptTest) {
+        const auto samples = makeSamples(300);
+        CaptureWriter writer;
+        auto capture = encode(samples, writer);
+        capture.resize(capture.size() - 10);
+        CaptureReader reader(capture.data(), capture.size());
+        std::vector<SensorData> decoded(samples.size());
+        EXPECT_EQ(2u * CaptureWriter::SamplesPerBlock, reader.read(decoded.data(), decoded.size())) << "Complete blocks decoded";
+        EXPECT_TRUE(reader.hasError()) << "Truncated block detected";
+        reader.rewind();
+        capture[0] = 0;
+        EXPECT_EQ(0u, reader.read(decoded.data(), decoded.size())) << "Wrong block marker";
+        EXPECT_TRUE(reader.hasError()) << "Wrong block marker detected";
+    }
+
+    TEST(CaptureTest, captureReplayTest) {
+        const auto samples = makeSamples(500);
+        CaptureWriter writer;
+        const auto blocks = encode(samples, writer);
+        std::vector<byte> capture(ReplayHeader::Size);
+        ReplayHeader header;
+        header.gain = 3000;
+        header.noiseRange = 60;
+        header.sampleRate = 100;
+        header.encoding = CaptureDelta;
+        header.write(capture.data());
+        capture.insert(capture.end(), blocks.begin(), blocks.end());
+
+        MagnetoSensorReplay replay;
+        EXPECT_TRUE(replay.attach(capture.data(), capture.size())) << "Attached";
+        replay.begin();
+        EXPECT_EQ(500u, replay.getSampleCount()) << "Sample count from the blocks";
+        SensorData sample{};
+        EXPECT_TRUE(replay.read(sample)) << "Read one";
+        EXPECT_EQ(samples[0], sample) << "First sample ok";
+        std::vector<SensorData> decoded(samples.size());
+        EXPECT_EQ(499u, replay.readBatch(decoded.data(), decoded.size())) << "Read the rest";
+        EXPECT_EQ(samples[499], decoded[498]) << "Last sample ok";
+        replay.rewind();
+        EXPECT_TRUE(replay.read(sample)) << "Read after rewind";
+        EXPECT_EQ(samples[0], sample) << "First sample again";
+    }
+}
@@ -0,0 +1,119 @@
+// Copyright 2024 Rik Essenius
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+// except in compliance with the License. You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and limitations under the License.
+
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <cmath>
+#include <CicDecimator.h>
+#include <MagnetoSensorQmc.h>
+
+namespace MagnetoSensorsTest {
+    using namespace MagnetoSensors;
+
+    namespace {
+        constexpr double Pi = 3.14159265358979;
+
+        // the amplitude of a sine on the x axis of the output (from the RMS, so it doesn't depend on the phase
+        // of the output samples), after the filter settled
+        int decimatedAmplitude(CicDecimator& decimator, const double frequency, const double sampleRate) {
+            decimator.reset();
+            double sumOfSquares = 0;
+            int count = 0;
+            for (int i = 0; i < 4000; i++) {
+                const auto x = static_cast<short>(std::lround(1000 * std::sin(2 * Pi * frequency * i / sampleRate)));
+                SensorData output{};
+                if (decimator.add({ x, 0, 0 }, output) && i >= 2000) {
+                    sumOfSquares += static_cast<double>(output.x) * output.x;
+                    count++;
+                }
+            }
+            return static_cast<int>(std::lround(std::sqrt(2 * sumOfSquares / count)));
+        }
+    }
+
+    TEST(CicDecimatorTest, cicDecimatorRateTest) {
+        const double inputRate = MagnetoSensorQmc::getSampleRate(QmcRate200Hz);
+        const unsigned int ratio = MagnetoSensorQmc::getSampleRate(QmcRate200Hz) /
+            MagnetoSensorQmc::getSampleRate(QmcRate50Hz);
+        CicDecimator decimator;
+        ASSERT_TRUE(decimator.configure(ratio)) << "200 Hz to 50 Hz";
+        EXPECT_EQ(4u, decimator.getRatio()) << "Ratio";
+
+        SensorData output{};
+        for (unsigned int i = 1; i < ratio; i++) {
+            EXPECT_FALSE(decimator.add({ 1000, -2000, 32767 }, output)) << "No output yet " << i;
+        }
+        EXPECT_TRUE(decimator.add({ 1000, -2000, 32767 }, output)) << "Output at the ratio";
+        EXPECT_EQ(SensorData({ 1000, -2000, 32767 }), output) << "Starts settled, DC gain 1";
+
+        // the CIC filter has zeros at multiples of the output rate, so what would alias to low frequencies goes
+        EXPECT_GT(20, decimatedAmplitude(decimator, 48, inputRate)) << "48 Hz (aliases to 2 Hz) removed";
+        EXPECT_NEAR(1000, decimatedAmplitude(decimator, 2, inputRate), 10) << "2 Hz passes";
+
+        // the compensation stage flattens the droop at the high end of the pass band
+        const int compensated = decimatedAmplitude(decimator, 10, inputRate);
+        EXPECT_NEAR(1000, compensated, 30) << "Compensated 10 Hz";
+        decimator.configure(ratio, 3, false);
+        const int uncompensated = decimatedAmplitude(decimator, 10, inputRate);
+        EXPECT_GT(900, uncompensated) << "CIC droop at 10 Hz";
+
+        EXPECT_TRUE(decimator.configure(40, 3)) << "Gain 64000 fits";
+        EXPECT_FALSE(decimator.configure(41, 3)) << "Gain 68921 doesn't fit";
+        EXPECT_FALSE(decimator.configure(2, 5)) << "Order too high";
+        EXPECT_FALSE(decimator.configure(0, 1)) << "Ratio 0";
+        EXPECT_EQ(40u, decimator.getRatio()) << "Configuration kept after a failure";
+
+        // 40 ^ 3 is not a power of two, so the gain correction needs rounding
+        SensorData samples[200];
+        std::fill(samples, samples + 200, SensorData{ -32767, 12345, -1 });
+        EXPECT_EQ(5u, decimator.apply(samples, 200, samples)) << "Decimated in place";
+        for (size_t i = 0; i < 5; i++) EXPECT_EQ(SensorData({ -32767, 12345, -1 }), samples[i]) << "Exact at " << i;
+    }
+
+    TEST(CicDecimatorTest, cicDecimatorSaturationTest) {
+        CicDecimator decimator;
+        decimator.configure(4, 2);
+        constexpr size_t Count = 64;
+        SensorData input[Count];
+        for (size_t i = 0; i < Count; i++) input[i] = { static_cast<short>(i * 100), static_cast<short>(-i), 5 };
+        input[21].x = SHRT_MIN;
+        SensorData output[Count / 4];
+        ASSERT_EQ(Count / 4, decimator.apply(input, Count, output)) << "16 outputs";
+        // the output at input i (i = 3, 7, ...) depends on inputs i - 7 to i, and the compensation adds 8 more
+        for (size_t i = 0; i < Count / 4; i++) {
+            const size_t lastInput = i * 4 + 3;
+            const bool touched = lastInput >= 21 && lastInput < 21 + 16;
+            EXPECT_EQ(touched, output[i].x == SHRT_MIN) << "x saturated only where affected, output " << i;
+            EXPECT_NE(SHRT_MIN, output[i].y) << "y not affected, output " << i;
+            EXPECT_EQ(5, output[i].z) << "z constant, output " << i;
+        }
+
+        // stream and block give the same result
+        decimator.reset();
+        size_t outputCount = 0;
+        for (const auto& sample : input) {
+            SensorData result{};
+            if (decimator.add(sample, result)) {
+                EXPECT_EQ(output[outputCount], result) << "Same as block " << outputCount;
+                outputCount++;
+            }
+        }
+        EXPECT_EQ(Count / 4, outputCount) << "Same number of outputs";
+
+        // ratio 1 without compensation just passes the samples
+        decimator.configure(1, 1, false);
+        SensorData result{};
+        EXPECT_TRUE(decimator.add({ 1, 2, 3 }, result)) << "Output for every input";
+        EXPECT_EQ(SensorData({ 1, 2, 3 }), result) << "Passed through";
+        EXPECT_TRUE(decimator.add({ -4, SHRT_MIN, 6 }, result)) << "Output for the next";
+        EXPECT_EQ(SensorData({ -4, SHRT_MIN, 6 }), result) << "Saturated axis passed through";
+    }
+}
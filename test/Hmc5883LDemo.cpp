@@ -18,15 +18,17 @@
 
 #include <Wire.h>
 #include <MagnetoSensorHmc.h>
+#include <SampleScheduler.h>
 
 using namespace MagnetoSensors;
 
 namespace Hmc5883LDemo {
 
     constexpr uint8_t PowerPin = 15;
-    constexpr int SampleTime = 10000;
+    constexpr unsigned long SampleTime = 10000;
 
     MagnetoSensorHmc sensor(&Wire);
+    SampleScheduler scheduler(&sensor, SampleTime);
 
     void printSampleWithDuration(const SensorData& sample, const unsigned long sampleDuration) {
         Serial.printf("x:%d, y:%d, z:%d", sample.x, sample.y, sample.z);
@@ -34,8 +36,9 @@ namespace Hmc5883LDemo {
     }
 
     void readSample(const bool print = true) {
-        const unsigned long startTime = micros();
         SensorData sample;
+        scheduler.waitForSlot();
+        const unsigned long startTime = micros();
         sensor.read(sample);
         if (sample.isSaturated()) {
             sensor.increaseRange();
@@ -44,7 +47,6 @@ namespace Hmc5883LDemo {
             const auto sampleDuration = micros() - startTime;
             printSampleWithDuration(sample, sampleDuration);
         }
-        while (micros() - startTime < SampleTime);
     }
 
     void setup() {
@@ -65,6 +67,7 @@ namespace Hmc5883LDemo {
             Serial.println("Sensor test failed");
             for (;;);
         }
+        scheduler.begin();
         // Get the sensor started. The first few results might not be reliable
         for (int i = 0; i < 5; i++) {
             readSample(false);
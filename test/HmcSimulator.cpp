@@ -0,0 +1,178 @@
+// Copyright 2024 Rik Essenius
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+// except in compliance with the License. You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and limitations under the License.
+
+#include "HmcSimulator.h"
+#include <cmath>
+
+namespace MagnetoSensorsTest {
+    namespace {
+        constexpr byte ControlA = 0;
+        constexpr byte ControlB = 1;
+        constexpr byte Mode = 2;
+        constexpr byte DataFirst = 3;
+        constexpr byte DataLast = 8;
+        constexpr byte Status = 9;
+        constexpr byte IdFirst = 10;
+        constexpr byte Ready = 0x01;
+        constexpr byte Lock = 0x02;
+        constexpr byte ModeMask = 0x03;
+        constexpr byte ModeContinuous = 0;
+        constexpr byte ModeSingle = 1;
+        constexpr byte ModeIdle = 3;
+        constexpr byte BiasMask = 0x03;
+        constexpr byte PositiveBias = 1;
+        constexpr byte NegativeBias = 2;
+        constexpr short Saturated = -4096;
+        constexpr short AdcMin = -2048;
+        constexpr short AdcMax = 2047;
+        constexpr double Gains[] = { 1370, 1090, 820, 660, 440, 390, 330, 230 };
+        // in milli-Hertz
+        constexpr unsigned long Rates[] = { 750, 1500, 3000, 7500, 15000, 30000, 75000, 75000 };
+        // self test field in Gauss: X, Y, Z
+        constexpr double SelfTestField[] = { 1.16, 1.16, 1.08 };
+    }
+
+    constexpr unsigned long HmcSimulator::SingleMeasurementMicros;
+    constexpr unsigned long HmcSimulator::ReadyLowMicros;
+
+    HmcSimulator::HmcSimulator() : I2cSimulator(0x1E) {
+        reset();
+    }
+
+    void HmcSimulator::reset() {
+        for (auto& value : _registers) value = 0;
+        _converting = false;
+        _continuous = false;
+        _isWriting = false;
+        _registers[ControlA] = 0x10;
+        _registers[ControlB] = 0x20;
+        _registers[Mode] = ModeSingle;
+        _registers[IdFirst] = 'H';
+        _registers[IdFirst + 1] = '4';
+        _registers[IdFirst + 2] = '3';
+        _activeGain = getGain();
+    }
+
+    void HmcSimulator::beginRead() {
+        _dataRead = 0;
+    }
+
+    void HmcSimulator::endRead() {
+        // reading all data registers unlocks them; reading only some locks them. RDY stays as it is.
+        if (_dataRead == DataLast - DataFirst + 1) {
+            _registers[Status] = static_cast<byte>(_registers[Status] & ~Lock);
+        }
+        else if (_dataRead > 0) {
+            _registers[Status] |= Lock;
+        }
+    }
+
+    double HmcSimulator::getGain() const {
+        return Gains[_registers[ControlB] >> 5];
+    }
+
+    unsigned long HmcSimulator::getPeriod() const {
+        constexpr unsigned long MicrosPerKiloSecond = 1000000000UL;
+        return MicrosPerKiloSecond / Rates[(_registers[ControlA] >> 2) & 0x07];
+    }
+
+    void HmcSimulator::latch() {
+        if ((_registers[Status] & Lock) != 0) return;
+        const short x = toCounts(_field[0], SelfTestField[0], _conversionGain);
+        const short y = toCounts(_field[1], SelfTestField[1], _conversionGain);
+        const short z = toCounts(_field[2], SelfTestField[2], _conversionGain);
+        // order: X, Z, Y, MSB first
+        const short values[] = { x, z, y };
+        for (int i = 0; i < 3; i++) {
+            _registers[DataFirst + 2 * i] = static_cast<byte>((values[i] >> 8) & 0xff);
+            _registers[DataFirst + 2 * i + 1] = static_cast<byte>(values[i] & 0xff);
+        }
+        // writing the data clears RDY for a while
+        _registers[Status] = static_cast<byte>(_registers[Status] & ~Ready);
+        _isWriting = true;
+        _readyAt = _conversionEnd + ReadyLowMicros;
+        _measurements++;
+    }
+
+    byte HmcSimulator::readRegister(const byte sensorRegister) {
+        if (sensorRegister >= DataFirst && sensorRegister <= DataLast) _dataRead++;
+        return I2cSimulator::readRegister(sensorRegister);
+    }
+
+    void HmcSimulator::setField(const double x, const double y, const double z) {
+        _field[0] = x;
+        _field[1] = y;
+        _field[2] = z;
+    }
+
+    void HmcSimulator::startConversion() {
+        _converting = true;
+        // a new gain is effective from the second measurement after writing ControlB
+        if (_keepGain) _keepGain = false;
+        else _activeGain = getGain();
+        _conversionGain = _activeGain;
+        _conversionBias = _registers[ControlA] & BiasMask;
+        _conversionEnd = now() + (_continuous ? getPeriod() : SingleMeasurementMicros);
+    }
+
+    short HmcSimulator::toCounts(const double field, const double bias, const double gain) {
+        double total = field;
+        if (_conversionBias == PositiveBias) total += bias;
+        else if (_conversionBias == NegativeBias) total -= bias;
+        const long counts = std::lround(total * gain) + noise(_noise);
+        if (counts < AdcMin || counts > AdcMax) return Saturated;
+        return static_cast<short>(counts);
+    }
+
+    void HmcSimulator::update() {
+        while (_converting && static_cast<long>(now() - _conversionEnd) >= 0) {
+            latch();
+            if (_continuous) {
+                const unsigned long end = _conversionEnd;
+                startConversion();
+                // stay on the grid of the rate
+                _conversionEnd = end + getPeriod();
+            }
+            else {
+                _converting = false;
+                _registers[Mode] = static_cast<byte>((_registers[Mode] & ~ModeMask) | ModeIdle);
+            }
+        }
+        if (_isWriting && static_cast<long>(now() - _readyAt) >= 0) {
+            _registers[Status] |= Ready;
+            _isWriting = false;
+        }
+    }
+
+    void HmcSimulator::writeRegister(const byte sensorRegister, const byte value) {
+        // data, status and identification registers are read only
+        if (sensorRegister > Mode) return;
+        I2cSimulator::writeRegister(sensorRegister, value);
+        // if a conversion is running, that one is the first measurement (and it has the old gain already)
+        if (sensorRegister == ControlB) _keepGain = !_converting;
+        if (sensorRegister != Mode) return;
+        switch (value & ModeMask) {
+            case ModeContinuous:
+                _continuous = true;
+                startConversion();
+                break;
+            case ModeSingle:
+                // a request while a single measurement runs doesn't restart it
+                if (_converting && !_continuous) break;
+                _continuous = false;
+                startConversion();
+                break;
+            default:
+                _continuous = false;
+                _converting = false;
+        }
+    }
+}
@@ -0,0 +1,79 @@
+// Copyright 2024 Rik Essenius
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+// except in compliance with the License. You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and limitations under the License.
+
+// Simulates the HMC5883L registers. What we model:
+// * single measurement (done after SingleMeasurementMicros, then idle) and continuous mode at the configured rate.
+//   Requesting a single measurement while one runs doesn't restart it. The datasheet only gives 6 ms (typical)
+//   for a single measurement, not a time per averaging setting, so that doesn't depend on the oversampling.
+// * gain per range, with the 12 bit ADC saturating to -4096
+// * the gain of a measurement is the one at the start of it, so the first one after a change uses the old gain
+// * positive and negative self test bias
+// * RDY is cleared when a conversion writes the data registers, and set again ReadyLowMicros later.
+//   Reading doesn't clear it, so it stays set from the previous result while the next conversion runs.
+// * while some but not all data registers were read, LOCK is set and new data doesn't get written.
+//   Reading the rest clears it.
+// * the identification registers
+
+#ifndef HEADER_HMC_SIMULATOR
+#define HEADER_HMC_SIMULATOR
+
+#include "I2cSimulator.h"
+
+namespace MagnetoSensorsTest {
+    class HmcSimulator : public I2cSimulator {
+    public:
+        static constexpr unsigned long SingleMeasurementMicros = 6000;
+        static constexpr unsigned long ReadyLowMicros = 250;
+
+        HmcSimulator();
+
+        // back to the power-on register values, like after a brownout
+        void reset();
+
+        byte getRegister(const byte sensorRegister) const { return _registers[sensorRegister]; }
+        unsigned long getMeasurements() const { return _measurements; }
+
+        // the field the sensor sees, in Gauss
+        void setField(double x, double y, double z);
+
+        // noise in counts, added to each axis
+        void setNoise(int amplitude) { _noise = amplitude; }
+
+    protected:
+        void beginRead() override;
+        void endRead() override;
+        byte readRegister(byte sensorRegister) override;
+        void update() override;
+        void writeRegister(byte sensorRegister, byte value) override;
+
+    private:
+        double getGain() const;
+        unsigned long getPeriod() const;
+        short toCounts(double field, double bias, double gain);
+        void latch();
+        void startConversion();
+
+        double _field[3] {};
+        int _noise = 0;
+        bool _converting = false;
+        bool _continuous = false;
+        unsigned long _conversionEnd = 0;
+        bool _isWriting = false;
+        unsigned long _readyAt = 0;
+        double _activeGain = 0;
+        double _conversionGain = 0;
+        bool _keepGain = false;
+        byte _conversionBias = 0;
+        byte _dataRead = 0;
+        unsigned long _measurements = 0;
+    };
+}
+#endif
@@ -0,0 +1,95 @@
+// Copyright 2024 Rik Essenius
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+// except in compliance with the License. You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and limitations under the License.
+
+#include "I2cSimulator.h"
+
+namespace MagnetoSensorsTest {
+    I2cSimulator::I2cSimulator(const uint8_t address) : _address(address) {}
+
+    void I2cSimulator::advance(const unsigned long micros) {
+        _offset += micros;
+        update();
+    }
+
+    int I2cSimulator::available() {
+        return static_cast<int>(_readCount - _readIndex);
+    }
+
+    void I2cSimulator::beginTransmission(const uint8_t address) {
+        _addressed = _connected && address == _address;
+        _writeCount = 0;
+    }
+
+    uint8_t I2cSimulator::endTransmission(bool /*sendStop*/) {
+        // address byte plus the data
+        transfer(_writeCount + 1);
+        if (!_addressed) return NackAddress;
+        update();
+        if (_writeCount > 0) _pointer = _writeBuffer[0];
+        for (size_t i = 1; i < _writeCount; i++) {
+            writeRegister(_pointer, _writeBuffer[i]);
+            _pointer = nextPointer(_pointer);
+        }
+        return 0;
+    }
+
+    byte I2cSimulator::nextPointer(const byte current) const {
+        return static_cast<byte>((current + 1) % RegisterCount);
+    }
+
+    int I2cSimulator::noise(const int amplitude) {
+        if (amplitude == 0) return 0;
+        // simple LCG is good enough here
+        _random = _random * 1103515245UL + 12345UL;
+        const auto value = static_cast<int>((_random >> 16) % (2 * amplitude + 1));
+        return value - amplitude;
+    }
+
+    int I2cSimulator::read() {
+        if (_readIndex >= _readCount) return -1;
+        return _readBuffer[_readIndex++];
+    }
+
+    byte I2cSimulator::readRegister(const byte sensorRegister) {
+        return _registers[sensorRegister];
+    }
+
+    uint8_t I2cSimulator::requestFrom(const uint8_t address, const size_t size, bool /*sendStop*/) {
+        _readCount = 0;
+        _readIndex = 0;
+        transfer(size + 1);
+        if (!_connected || address != _address) return 0;
+        update();
+        beginRead();
+        while (_readCount < size && _readCount < sizeof _readBuffer) {
+            _readBuffer[_readCount++] = readRegister(_pointer);
+            _pointer = nextPointer(_pointer);
+        }
+        endRead();
+        return static_cast<uint8_t>(_readCount);
+    }
+
+    void I2cSimulator::transfer(const size_t bytes) {
+        _transactions++;
+        _bytesTransferred += bytes;
+        _offset += bytes * ByteMicros;
+    }
+
+    size_t I2cSimulator::write(const uint8_t value) {
+        if (_writeCount >= sizeof _writeBuffer) return 0;
+        _writeBuffer[_writeCount++] = value;
+        return 1;
+    }
+
+    void I2cSimulator::writeRegister(const byte sensorRegister, const byte value) {
+        _registers[sensorRegister] = value;
+    }
+}
@@ -0,0 +1,87 @@
+// Copyright 2024 Rik Essenius
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+// except in compliance with the License. You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and limitations under the License.
+
+// Register level simulation of an I2C device behind the TwoWire interface, so the real drivers can talk to it.
+// Like the Arduino implementation, writes are buffered until endTransmission, and requestFrom does the whole read.
+// The register pointer auto-increments; the chip specific subclasses decide how.
+//
+// The simulation clock follows micros(), so a delay() in a driver lets time pass. On top of that it advances
+// with the bus traffic (400 kHz) and via advance(). Without real time that keeps it deterministic.
+
+#ifndef HEADER_I2C_SIMULATOR
+#define HEADER_I2C_SIMULATOR
+
+#include <ESP.h>
+#include <Wire.h>
+
+namespace MagnetoSensorsTest {
+    class I2cSimulator : public TwoWire {
+    public:
+        explicit I2cSimulator(uint8_t address);
+
+        int available() override;
+        void beginTransmission(uint8_t address) override;
+        uint8_t endTransmission(bool sendStop = true) override;
+        int read() override;
+        uint8_t requestFrom(uint8_t address, size_t size, bool sendStop = true) override;
+        size_t write(uint8_t value) override;
+
+        // let simulated time pass
+        void advance(unsigned long micros);
+
+        unsigned long getBytesTransferred() const { return _bytesTransferred; }
+        unsigned long getTransactions() const { return _transactions; }
+        unsigned long now() const { return micros() + _offset; }
+
+        // a disconnected device doesn't acknowledge anything
+        void setConnected(bool connected) { _connected = connected; }
+
+        // make values that don't depend on bus traffic reproducible
+        void seed(unsigned long seed) { _random = seed; }
+
+    protected:
+        static constexpr byte RegisterCount = 16;
+        // 9 bits per byte at 400 kHz, rounded up
+        static constexpr unsigned long ByteMicros = 23;
+        static constexpr byte NackAddress = 2;
+
+        // uniformly distributed in [-amplitude, amplitude]
+        int noise(int amplitude);
+
+        // chip specific behavior
+        virtual void beginRead() {}
+        virtual void endRead() {}
+        virtual byte nextPointer(byte current) const;
+        virtual byte readRegister(byte sensorRegister);
+        virtual void update() = 0;
+        virtual void writeRegister(byte sensorRegister, byte value);
+
+        byte _registers[RegisterCount] {};
+        byte _pointer = 0;
+
+    private:
+        void transfer(size_t bytes);
+
+        uint8_t _address;
+        bool _connected = true;
+        bool _addressed = false;
+        unsigned long _offset = 0;
+        unsigned long _transactions = 0;
+        unsigned long _bytesTransferred = 0;
+        unsigned long _random = 1;
+        byte _writeBuffer[RegisterCount + 1] {};
+        size_t _writeCount = 0;
+        byte _readBuffer[RegisterCount * 2] {};
+        size_t _readCount = 0;
+        size_t _readIndex = 0;
+    };
+}
+#endif
@@ -93,7 +93,8 @@ namespace MagnetoSensorsTest {
         Wire.begin();
         sensor.begin();
         EXPECT_EQ(0x1e, Wire.getAddress()) << "Default address OK";
-        constexpr uint8_t BufferBegin[] = {0, 0x78, 1, 0xa0, 2, 0x01, 2, 0x01, 3};
+        // control A, control B and mode in one transaction, then the pipelined read starts the next measurement
+        constexpr uint8_t BufferBegin[] = {0, 0x78, 0xa0, 0x01, 2, 0x01, 3};
         EXPECT_EQ(sizeof BufferBegin, Wire.writeMismatchIndex(BufferBegin, sizeof BufferBegin)) << "writes for begin ok";
         // we are at the default address so the sensor should report it's on
         Wire.setEndTransmissionTogglePeriod(1);
@@ -129,7 +130,102 @@ namespace MagnetoSensorsTest {
         // ensure all test variables are reset
         Wire.begin();
         sensor.begin();
-        constexpr uint8_t BufferReconfigure[] = {0, 0x54, 1, 0xc0, 2, 0x01, 2, 0x01, 3};
+        constexpr uint8_t BufferReconfigure[] = {0, 0x54, 0xc0, 0x01, 2, 0x01, 3};
         EXPECT_EQ(sizeof BufferReconfigure, Wire.writeMismatchIndex(BufferReconfigure, sizeof BufferReconfigure)) << "writes for reconfigure ok";
     }
+
+    TEST(MagnetoSensorHmcTest, readBatchTest) {
+        setRealTime(false);
+        MagnetoSensorHmc sensor(&Wire);
+        Wire.begin();
+        sensor.begin();
+        Wire.begin();
+        // status 0x01 means ready, data words are then 0x0101
+        Wire.setFlatline(true, 0x01);
+        SensorData samples[3]{};
+        unsigned long timestamps[3]{};
+        EXPECT_EQ(3u, sensor.readBatch(samples, 3, timestamps)) << "All samples read";
+        constexpr uint8_t BufferBatch[] = {2, 0x01, 9, 3, 2, 0x01, 9, 3};
+        EXPECT_EQ(sizeof BufferBatch, Wire.writeMismatchIndex(BufferBatch, sizeof BufferBatch)) << "measure, wait for ready, read";
+        for (const auto& sample : samples) {
+            EXPECT_EQ(0x0101, sample.x) << "X ok";
+            EXPECT_EQ(0x0101, sample.y) << "Y ok";
+            EXPECT_EQ(0x0101, sample.z) << "Z ok";
+        }
+        // RDY is always set here, as it would be from the previous measurement. That doesn't make the new one ready.
+        EXPECT_LE(6000u, timestamps[1] - timestamps[0]) << "Waited for the conversion";
+        EXPECT_LE(6000u, timestamps[2] - timestamps[1]) << "Waited for the conversion";
+
+        // status never gets ready
+        Wire.setFlatline(true, 0x00);
+        EXPECT_EQ(0u, sensor.readBatch(samples, 3)) << "Timed out waiting for ready";
+        Wire.setFlatline(false, 0);
+    }
+
+    TEST(MagnetoSensorHmcTest, splitPhaseReadTest) {
+        setRealTime(false);
+        MagnetoSensorHmc sensor(&Wire);
+        Wire.begin();
+        SensorData sample{};
+        EXPECT_FALSE(sensor.tryCollect(sample)) << "Nothing to collect before starting";
+        sensor.startSample();
+        // RDY may still be set from the previous measurement, so it only counts once the conversion had time to finish
+        Wire.setFlatline(true, 0x01);
+        EXPECT_FALSE(sensor.tryCollect(sample)) << "Too early, and the bus wasn't used";
+        delay(7);
+        // status 0x00 means the conversion is still running
+        Wire.setFlatline(true, 0x00);
+        EXPECT_FALSE(sensor.tryCollect(sample)) << "Not ready yet";
+        Wire.setFlatline(true, 0x01);
+        EXPECT_TRUE(sensor.tryCollect(sample)) << "Collected";
+        EXPECT_EQ(0x0101, sample.x) << "X ok";
+        EXPECT_EQ(0x0101, sample.y) << "Y ok";
+        EXPECT_EQ(0x0101, sample.z) << "Z ok";
+        EXPECT_FALSE(sensor.tryCollect(sample)) << "Already collected";
+        constexpr uint8_t BufferSplitPhase[] = {2, 0x01, 9, 9, 3};
+        EXPECT_EQ(sizeof BufferSplitPhase, Wire.writeMismatchIndex(BufferSplitPhase, sizeof BufferSplitPhase)) << "start, poll twice, read";
+        Wire.setFlatline(false, 0);
+    }
+
+    TEST(MagnetoSensorHmcTest, continuousModeTest) {
+        setRealTime(false);
+        MagnetoSensorHmc sensor(&Wire);
+        sensor.configureRate(HmcRate75, HmcContinuous);
+        Wire.begin();
+        // acknowledge every write, or the register shadow can't skip anything
+        Wire.setEndTransmissionTogglePeriod(0);
+        sensor.begin();
+        constexpr uint8_t BufferBegin[] = {0, 0x78, 0xa0, 0x00, 3};
+        EXPECT_EQ(sizeof BufferBegin, Wire.writeMismatchIndex(BufferBegin, sizeof BufferBegin)) << "writes for begin ok";
+
+        Wire.begin();
+        sensor.softReset();
+        EXPECT_EQ(sizeof BufferBegin, Wire.writeMismatchIndex(BufferBegin, sizeof BufferBegin)) << "soft reset writes all control registers again";
+
+        Wire.begin();
+        // status 0x01 means ready
+        Wire.setFlatline(true, 0x01);
+        SensorData sample{};
+        EXPECT_TRUE(sensor.read(sample)) << "Read OK";
+        EXPECT_EQ(0x0101, sample.x) << "X ok";
+        EXPECT_EQ(0x0101, sample.y) << "Y ok";
+        EXPECT_EQ(0x0101, sample.z) << "Z ok";
+        constexpr uint8_t BufferRead[] = {3};
+        EXPECT_EQ(sizeof BufferRead, Wire.writeMismatchIndex(BufferRead, sizeof BufferRead)) << "Only the data pointer was written";
+
+        // RDY stays set after reading, so it doesn't mean there is a new sample
+        EXPECT_FALSE(sensor.read(sample)) << "Same data within a period";
+        delay(14);
+        EXPECT_TRUE(sensor.read(sample)) << "Same data, but a period passed (75 Hz)";
+        SensorData samples[3]{};
+        unsigned long timestamps[3]{};
+        EXPECT_EQ(3u, sensor.readBatch(samples, 3, timestamps)) << "Batch read";
+        EXPECT_LE(13333u, timestamps[1] - timestamps[0]) << "Paced on the period";
+        EXPECT_LE(13333u, timestamps[2] - timestamps[1]) << "Paced on the period";
+
+        Wire.setFlatline(true, 0x00);
+        delay(14);
+        EXPECT_FALSE(sensor.read(sample)) << "Not ready";
+        Wire.setFlatline(false, 0);
+    }
 }
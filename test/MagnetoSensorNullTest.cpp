@@ -20,7 +20,7 @@ namespace MagnetoSensorsTest {
         MagnetoSensorNull nullSensor;
         EXPECT_FALSE(nullSensor.begin()) << "begin() returns false";
         EXPECT_TRUE(nullSensor.isOn()) << "IsOn() returns true";
-        nullSensor.waitForPowerOff(); // doesn't wait
+        EXPECT_TRUE(nullSensor.waitForPowerOff()) << "Doesn't wait";
         EXPECT_TRUE(nullSensor.handlePowerOn()) << "handlePowerOn returns true";
         EXPECT_EQ(0.0, nullSensor.getGain()) << "Gain is 0";
         EXPECT_EQ(0, nullSensor.getNoiseRange()) << "Noise range is 0";
@@ -28,6 +28,7 @@ namespace MagnetoSensorsTest {
         EXPECT_FALSE(nullSensor.isReal()) << "nullSensor is not a real sensor";
         EXPECT_FALSE(nullSensor.read(sample)) << "Read returns false";
         EXPECT_EQ(0, sample.y) << "y was reset";
+        EXPECT_EQ(0u, nullSensor.readBatch(&sample, 1)) << "readBatch returns no samples";
         // validate that it doesn't break
         nullSensor.softReset();
     }
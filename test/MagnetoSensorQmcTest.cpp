@@ -57,7 +57,7 @@ namespace MagnetoSensorsTest {
         MagnetoSensorQmc sensor(&Wire);
         Wire.begin();
         sensor.begin();
-        constexpr uint8_t BufferBegin[] = {10, 0x80, 11, 0x01, 9, 0x19};
+        constexpr uint8_t BufferBegin[] = {10, 0x80, 11, 0x01, 10, 0x40, 9, 0x19};
         EXPECT_EQ(sizeof BufferBegin, Wire.writeMismatchIndex(BufferBegin, sizeof BufferBegin)) << "writes for begin ok";
         // we are at the default address so the sensor should report it's on
         Wire.setEndTransmissionTogglePeriod(1);
@@ -66,11 +66,29 @@ namespace MagnetoSensorsTest {
         // reset buffer
         Wire.begin();
         SensorData sample{};
-        sensor.read(sample);
-        // the mock returns values from 0 increasing by 1 for every read
-        EXPECT_EQ(0x0100, sample.x) << "X ok";
-        EXPECT_EQ(0x0302, sample.y) << "Y ok";
-        EXPECT_EQ(0x0504, sample.z) << "Z ok";
+        // the mock returns values from 0 increasing by 1 for every read. The first byte is the status.
+        // 0x00 has data ready off, so we should not get a sample.
+        EXPECT_FALSE(sensor.read(sample)) << "No new data";
+        EXPECT_EQ(0, sample.x) << "Sample untouched";
+        EXPECT_EQ(0u, sensor.getSkippedSamples()) << "Nothing skipped yet";
+        // status 0x07 has data ready, overflow and data skipped on
+        EXPECT_TRUE(sensor.read(sample)) << "New data";
+        EXPECT_EQ(0x0908, sample.x) << "X ok";
+        EXPECT_EQ(0x0b0a, sample.y) << "Y ok";
+        EXPECT_EQ(SHRT_MIN, sample.z) << "Z is the largest axis, so it is taken as saturated";
+        EXPECT_EQ(1u, sensor.getSkippedSamples()) << "Skipped sample reported";
+        // status 0x0e has data skipped on, but data ready off
+        EXPECT_FALSE(sensor.read(sample)) << "No new data";
+        EXPECT_EQ(2u, sensor.getSkippedSamples()) << "Skipped sample reported without new data";
+        // status 0x15 has data ready and data skipped on
+        EXPECT_TRUE(sensor.read(sample)) << "New data";
+        EXPECT_EQ(0x1716, sample.x) << "X ok";
+        EXPECT_EQ(0x1918, sample.y) << "Y ok";
+        EXPECT_EQ(0x1b1a, sample.z) << "Z ok";
+        EXPECT_EQ(3u, sensor.getSkippedSamples()) << "Skipped sample reported";
+        // the burst starts at the status register and rolls over to the data
+        constexpr uint8_t BufferRead[] = {6, 6, 6, 6};
+        EXPECT_EQ(sizeof BufferRead, Wire.writeMismatchIndex(BufferRead, sizeof BufferRead)) << "Status and data read in one go";
 
         // we configure another address so it reports off
         Wire.setEndTransmissionTogglePeriod(1);
@@ -85,7 +103,64 @@ namespace MagnetoSensorsTest {
         // ensure all test variables are reset
         Wire.begin();
         sensor.begin();
-        constexpr uint8_t BufferReconfigure[] = {10, 0x80, 11, 0x01, 9, 0x8d};
+        constexpr uint8_t BufferReconfigure[] = {10, 0x80, 11, 0x01, 10, 0x40, 9, 0x8d};
         EXPECT_EQ(sizeof BufferReconfigure, Wire.writeMismatchIndex(BufferReconfigure, sizeof BufferReconfigure)) << "Writes for reconfigure ok";
     }
+
+    TEST(MagnetoSensorQmcTest, readBatchTest) {
+        EXPECT_EQ(10u, MagnetoSensorQmc::getSampleRate(MagnetoSensors::QmcRate10Hz)) << "10 Hz";
+        EXPECT_EQ(200u, MagnetoSensorQmc::getSampleRate(QmcRate200Hz)) << "200 Hz";
+
+        MagnetoSensorQmc sensor(&Wire);
+        Wire.begin();
+        sensor.begin();
+        Wire.begin();
+        // status 0x01 means data ready, data words are then 0x0101
+        Wire.setFlatline(true, 0x01);
+        SensorData samples[2]{};
+        unsigned long timestamps[2]{};
+        EXPECT_EQ(2u, sensor.readBatch(samples, 2, timestamps)) << "All samples read";
+        constexpr uint8_t BufferBatch[] = {6, 6};
+        EXPECT_EQ(sizeof BufferBatch, Wire.writeMismatchIndex(BufferBatch, sizeof BufferBatch)) << "one read per sample";
+        EXPECT_EQ(0x0101, samples[1].x) << "X ok";
+        EXPECT_EQ(0x0101, samples[1].y) << "Y ok";
+        EXPECT_EQ(0x0101, samples[1].z) << "Z ok";
+        EXPECT_LE(timestamps[0], timestamps[1]) << "Timestamps increase";
+
+        Wire.setFlatline(true, 0x00);
+        EXPECT_EQ(0u, sensor.readBatch(samples, 2)) << "Timed out waiting for data ready";
+        Wire.setFlatline(false, 0);
+    }
+
+    TEST(MagnetoSensorQmcTest, overflowTest) {
+        MagnetoSensorQmc sensor(&Wire);
+        Wire.begin();
+        sensor.begin();
+        // status 0x7f has data ready and overflow on. No axis hits the rails, so the largest one is saturated.
+        Wire.setFlatline(true, 0x7f);
+        SensorData sample{};
+        EXPECT_TRUE(sensor.read(sample)) << "Read OK";
+        EXPECT_TRUE(sample.isSaturated()) << "Saturated";
+        EXPECT_EQ(SHRT_MIN, sample.x) << "X saturated";
+        EXPECT_EQ(0x7f7f, sample.y) << "Y not saturated";
+
+        // status 0x01 has data ready but no overflow, so the values are taken as is
+        Wire.setFlatline(true, 0x01);
+        EXPECT_TRUE(sensor.read(sample)) << "Read OK";
+        EXPECT_FALSE(sample.isSaturated()) << "Not saturated";
+        Wire.setFlatline(false, 0);
+    }
+
+    TEST(MagnetoSensorQmcTest, timeoutTest) {
+        MagnetoSensorQmc sensor(&Wire);
+        sensor.configureTimeouts(10, 500);
+        Wire.begin();
+        sensor.begin();
+        Wire.setFlatline(true, 0x00);
+        SensorData samples[2]{};
+        const auto start = micros();
+        EXPECT_EQ(0u, sensor.readBatch(samples, 2)) << "Never ready";
+        EXPECT_LT(micros() - start, 10000ul) << "Gave up within the configured deadline";
+        Wire.setFlatline(false, 0);
+    }
 }
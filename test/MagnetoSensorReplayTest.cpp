@@ -0,0 +1,118 @@
+// Copyright 2024 Rik Essenius
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+// except in compliance with the License. You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and limitations under the License.
+
+#include "gtest/gtest.h"
+#include <cstdio>
+#include <cstring>
+#include <MagnetoSensorReplay.h>
+
+namespace MagnetoSensorsTest {
+    using MagnetoSensors::MagnetoSensorReplay;
+    using MagnetoSensors::ReplayHeader;
+    using MagnetoSensors::SensorData;
+
+    namespace {
+        constexpr size_t SampleCount = 5;
+        constexpr size_t CaptureSize = ReplayHeader::Size + SampleCount * MagnetoSensorReplay::SampleSize;
+
+        void makeCapture(byte* capture, const uint32_t sampleCount = 0) {
+            ReplayHeader header;
+            header.gain = 390.0;
+            header.noiseRange = 3;
+            header.sampleRate = 100;
+            header.sampleCount = sampleCount;
+            header.write(capture);
+            for (size_t i = 0; i < SampleCount; i++) {
+                const SensorData sample{ static_cast<short>(i), static_cast<short>(-10 * i), static_cast<short>(100 * i) };
+                memcpy(capture + ReplayHeader::Size + i * MagnetoSensorReplay::SampleSize, &sample, sizeof sample);
+            }
+        }
+    }
+
+    TEST(MagnetoSensorReplayTest, replayBufferTest) {
+        byte capture[CaptureSize];
+        makeCapture(capture);
+        MagnetoSensorReplay replay;
+        EXPECT_FALSE(replay.isOn()) << "Not on without a capture";
+        EXPECT_TRUE(replay.attach(capture, sizeof capture)) << "Attached";
+        EXPECT_TRUE(replay.begin()) << "Started";
+        EXPECT_TRUE(replay.isOn()) << "On with a capture";
+        EXPECT_EQ(390.0, replay.getGain()) << "Gain from the header";
+        EXPECT_EQ(3, replay.getNoiseRange()) << "Noise range from the header";
+        EXPECT_EQ(100u, replay.getSampleRate()) << "Sample rate from the header";
+        EXPECT_EQ(SampleCount, replay.getSampleCount()) << "Sample count from the size";
+
+        SensorData sample{};
+        EXPECT_TRUE(replay.read(sample)) << "First sample";
+        EXPECT_EQ((SensorData{0, 0, 0}), sample) << "First sample ok";
+        EXPECT_TRUE(replay.read(sample)) << "Second sample";
+        EXPECT_EQ((SensorData{1, -10, 100}), sample) << "Second sample ok";
+
+        SensorData samples[SampleCount]{};
+        unsigned long timestamps[SampleCount]{};
+        EXPECT_EQ(3u, replay.readBatch(samples, SampleCount, timestamps)) << "Rest of the samples";
+        EXPECT_EQ((SensorData{4, -40, 400}), samples[2]) << "Last sample ok";
+        EXPECT_EQ(10000ul, timestamps[1] - timestamps[0]) << "Timestamps follow the recorded rate";
+        EXPECT_FALSE(replay.read(sample)) << "End of capture";
+        EXPECT_EQ((SensorData{1, -10, 100}), sample) << "Sample untouched at the end";
+
+        replay.rewind();
+        EXPECT_EQ(0u, replay.getPosition()) << "Rewound";
+        EXPECT_TRUE(replay.read(sample)) << "Read after rewind";
+    }
+
+    TEST(MagnetoSensorReplayTest, replayHeaderTest) {
+        byte capture[CaptureSize];
+        makeCapture(capture, 2);
+        MagnetoSensorReplay replay;
+        EXPECT_TRUE(replay.attach(capture, sizeof capture)) << "Attached";
+        EXPECT_EQ(2u, replay.getSampleCount()) << "Sample count from the header";
+        EXPECT_FALSE(replay.attach(capture, ReplayHeader::Size - 1)) << "Too small for a header";
+        capture[0] = 'X';
+        EXPECT_FALSE(replay.attach(capture, sizeof capture)) << "Wrong magic rejected";
+        EXPECT_TRUE(replay.isOn()) << "Failed attach keeps the previous capture";
+    }
+
+    TEST(MagnetoSensorReplayTest, replayPacedTest) {
+        setRealTime(false);
+        byte capture[CaptureSize];
+        makeCapture(capture);
+        MagnetoSensorReplay replay;
+        replay.attach(capture, sizeof capture);
+        replay.configurePacing(true);
+        replay.begin();
+        const auto start = micros();
+        SensorData samples[SampleCount]{};
+        EXPECT_EQ(SampleCount, replay.readBatch(samples, SampleCount)) << "All samples";
+        EXPECT_GE(micros() - start, 40000ul) << "Paced at 100 Hz";
+    }
+
+    TEST(MagnetoSensorReplayTest, replayFileTest) {
+        byte capture[CaptureSize];
+        makeCapture(capture);
+        const char* path = "replayTest.bin";
+        FILE* file = fopen(path, "wb");
+        ASSERT_NE(nullptr, file) << "Can create capture file";
+        fwrite(capture, 1, sizeof capture, file);
+        fclose(file);
+
+        MagnetoSensorReplay replay;
+        EXPECT_FALSE(replay.open("nonexisting.bin")) << "Can't open nonexisting file";
+        EXPECT_TRUE(replay.open(path)) << "File mapped";
+        EXPECT_EQ(SampleCount, replay.getSampleCount()) << "Sample count ok";
+        SensorData samples[SampleCount]{};
+        EXPECT_EQ(SampleCount, replay.readBatch(samples, SampleCount)) << "All samples";
+        EXPECT_EQ((SensorData{3, -30, 300}), samples[3]) << "Sample from the file ok";
+        replay.close();
+        EXPECT_FALSE(replay.isOn()) << "Closed";
+        remove(path);
+    }
+}
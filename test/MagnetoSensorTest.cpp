@@ -15,6 +15,6 @@
 namespace MagnetoSensorsTest {
     TEST(MagnetoSensorTest, magnetoSensorIsOnTest) {
         MagnetoSensorMock mockSensor;
-        mockSensor.waitForPowerOff();
+        EXPECT_TRUE(mockSensor.waitForPowerOff()) << "Went off";
     }
 }
@@ -0,0 +1,124 @@
+// Copyright 2024 Rik Essenius
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+// except in compliance with the License. You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and limitations under the License.
+
+#include "gtest/gtest.h"
+#include <cmath>
+#include <random>
+#include <MagnetoSensorQmc.h>
+#include <NoiseEstimator.h>
+#include "QmcSimulator.h"
+
+namespace MagnetoSensorsTest {
+    using namespace MagnetoSensors;
+
+    namespace {
+        constexpr size_t Window = NoiseEstimator::WindowSize;
+        constexpr double Pi = 3.14159265358979;
+
+        // a slow pattern with normally distributed noise on top
+        class NoisySignal {
+        public:
+            explicit NoisySignal(const double sigma) : _noise(0.0, sigma) {}
+
+            SensorData next(const double amplitude = 500.0) {
+                const double angle = _index++ * 2 * Pi / 1000.0;
+                return {
+                    static_cast<short>(std::lround(amplitude * std::sin(angle) + _noise(_generator))),
+                    static_cast<short>(std::lround(amplitude * std::cos(angle) + 200 + _noise(_generator))),
+                    static_cast<short>(std::lround(-300 + _noise(_generator)))
+                };
+            }
+
+        private:
+            std::mt19937 _generator{ 42 };
+            std::normal_distribution<double> _noise;
+            unsigned long _index = 0;
+        };
+    }
+
+    TEST(NoiseEstimatorTest, noiseEstimateTest) {
+        NoiseEstimator estimator;
+        NoisySignal signal(5.0);
+        EXPECT_FALSE(estimator.isReady()) << "Not ready at start";
+        EXPECT_EQ(0, estimator.getNoiseRange()) << "No range yet";
+        // the first sample only sets the baseline for the differences
+        for (size_t i = 0; i <= Window; i++) estimator.add(signal.next());
+        EXPECT_TRUE(estimator.isReady()) << "Ready after one window";
+        for (size_t i = 0; i < 63 * Window; i++) estimator.add(signal.next());
+        for (int axis = 0; axis < 3; axis++) {
+            EXPECT_NEAR(5.0, estimator.getNoiseSigma(axis), 0.5) << "Sigma within 10%, axis " << axis;
+        }
+        EXPECT_NEAR(30, estimator.getNoiseRange(), 3) << "Range is about 6 sigma";
+        // the MAD of a small window of integers is coarse, so the odd window may get skipped
+        EXPECT_LE(60u, estimator.getAcceptedWindows()) << "Nearly all windows were quiet";
+        const auto rejected = estimator.getRejectedWindows();
+
+        // a spike in a window makes the standard deviation much larger than the MAD suggests
+        const float sigma = estimator.getNoiseSigma(0);
+        for (size_t i = 0; i < Window; i++) {
+            auto sample = signal.next();
+            if (i == 10) sample.x = static_cast<short>(sample.x + 1000);
+            estimator.add(sample);
+        }
+        EXPECT_EQ(rejected + 1, estimator.getRejectedWindows()) << "Window with spike rejected";
+        EXPECT_EQ(sigma, estimator.getNoiseSigma(0)) << "Estimate unchanged";
+
+        estimator.reset();
+        EXPECT_FALSE(estimator.isReady()) << "Not ready after reset";
+        EXPECT_EQ(0u, estimator.getAcceptedWindows()) << "Counters reset";
+    }
+
+    TEST(NoiseEstimatorTest, noiseLevelChangeTest) {
+        NoiseEstimator estimator;
+        NoisySignal quiet(2.0);
+        for (size_t i = 0; i <= 8 * Window; i++) estimator.add(quiet.next());
+        const int quietRange = estimator.getNoiseRange();
+        EXPECT_NEAR(12, quietRange, 2) << "Quiet range";
+
+        // much noisier: looks like activity at first, but after a while it must be the new noise floor
+        NoisySignal loud(10.0);
+        for (size_t i = 0; i < (NoiseEstimator::MaxRejectedInRow - 1) * Window; i++) estimator.add(loud.next());
+        EXPECT_EQ(quietRange, estimator.getNoiseRange()) << "Noisier windows ignored at first";
+        EXPECT_EQ(NoiseEstimator::MaxRejectedInRow - 1u, estimator.getRejectedWindows()) << "Rejected";
+        for (size_t i = 0; i < 40 * Window; i++) estimator.add(loud.next());
+        EXPECT_LT(45, estimator.getNoiseRange()) << "Adapted to the new noise floor";
+
+        // no noise at all still gives the rounding noise
+        estimator.reset();
+        for (size_t i = 0; i <= Window; i++) estimator.add({ 100, 200, 300 });
+        EXPECT_EQ(2, estimator.getNoiseRange()) << "Rounding noise";
+
+        // saturated samples make the window unusable
+        estimator.reset();
+        for (size_t i = 0; i <= Window; i++) estimator.add(i == 5 ? SensorData{ SHRT_MIN, 0, 0 } : quiet.next());
+        EXPECT_FALSE(estimator.isReady()) << "Window with a saturated sample skipped";
+    }
+
+    TEST(NoiseEstimatorTest, sensorNoiseRangeTest) {
+        setRealTime(false);
+        QmcSimulator simulator;
+        simulator.setField(0.3, 0.2, -0.4);
+        simulator.setNoise(10);
+        MagnetoSensorQmc sensor(&simulator);
+        NoiseEstimator estimator;
+        sensor.configureNoiseEstimator(&estimator);
+        sensor.begin();
+        EXPECT_EQ(60, sensor.getNoiseRange()) << "Fixed value until there is an estimate";
+        SensorData samples[4 * Window];
+        EXPECT_EQ(4 * Window, sensor.readBatch(samples, 4 * Window)) << "Read samples";
+        EXPECT_TRUE(estimator.isReady()) << "The sensor fed the estimator";
+        // uniform noise of +/- 10 has a sigma of about 6
+        EXPECT_NEAR(37, sensor.getNoiseRange(), 5) << "Estimated noise range";
+        EXPECT_TRUE(sensor.decreaseRange()) << "Range changed";
+        EXPECT_FALSE(estimator.isReady()) << "Estimate reset on range change";
+        EXPECT_EQ(60, sensor.getNoiseRange()) << "Back to the fixed value";
+    }
+}
@@ -0,0 +1,148 @@
+// Copyright 2024 Rik Essenius
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+// except in compliance with the License. You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and limitations under the License.
+
+#include "gtest/gtest.h"
+#include <cmath>
+#include <random>
+#include <MagnetoSensorQmc.h>
+#include <PulseDetector.h>
+#include "QmcSimulator.h"
+
+namespace MagnetoSensorsTest {
+    using namespace MagnetoSensors;
+
+    namespace {
+        constexpr double Pi = 3.14159265358979;
+
+        // a magnet rotating in the x-z plane on top of the earth's field, with noise within the noise range (60)
+        class RotatingField {
+        public:
+            explicit RotatingField(const double samplesPerRotation) : _step(2 * Pi / samplesPerRotation) {}
+
+            SensorData next() {
+                _angle += _step;
+                return {
+                    static_cast<short>(std::lround(700 * std::cos(_angle) + 200 + _noise(_generator))),
+                    static_cast<short>(std::lround(-150 + 100 * std::cos(_angle) + _noise(_generator))),
+                    static_cast<short>(std::lround(600 * std::sin(_angle) - 400 + _noise(_generator)))
+                };
+            }
+
+            void reverse() { _step = -_step; }
+
+        private:
+            double _step;
+            double _angle = 0.0;
+            std::mt19937 _generator{ 7 };
+            std::uniform_real_distribution<double> _noise{ -25.0, 25.0 };
+        };
+
+        // feed samples, 20 ms apart. Returns the number of events; the last one goes into event.
+        int feed(PulseDetector& detector, RotatingField& field, const int count, unsigned long& timestamp,
+                 PulseEvent& event) {
+            int events = 0;
+            for (int i = 0; i < count; i++) {
+                timestamp += 20000;
+                if (detector.update(field.next(), timestamp, event)) events++;
+            }
+            return events;
+        }
+    }
+
+    TEST(PulseDetectorTest, pulseDetectorRotationTest) {
+        QmcSimulator simulator;
+        const MagnetoSensorQmc sensor(&simulator);
+        PulseDetector detector(&sensor);
+        detector.begin();
+        RotatingField field(100);
+        unsigned long timestamp = 0;
+        PulseEvent event{};
+
+        // the first rotation builds up the envelopes
+        feed(detector, field, 150, timestamp, event);
+        EXPECT_EQ(0, detector.getPrimaryAxis()) << "x has the largest swing";
+        EXPECT_EQ(2, detector.getSecondaryAxis()) << "z is the other axis of the rotation";
+        const long count = detector.getCount();
+        const unsigned long previous = event.timestamp;
+        ASSERT_LT(0ul, previous) << "The rotation was counted once the envelopes were there";
+        EXPECT_EQ(1, feed(detector, field, 100, timestamp, event)) << "One pulse per rotation";
+        EXPECT_EQ(1, event.direction) << "Forward";
+        EXPECT_EQ(count + 1, event.count) << "Count in event";
+        EXPECT_EQ(2000000ul, event.timestamp - previous) << "100 samples of 20 ms per rotation";
+        EXPECT_EQ(9, feed(detector, field, 900, timestamp, event)) << "Nine more rotations";
+        EXPECT_EQ(count + 10, detector.getCount()) << "Net count";
+
+        // going back: the count goes down
+        field.reverse();
+        feed(detector, field, 100, timestamp, event);
+        const long turned = detector.getCount();
+        const unsigned long pulses = detector.getPulses();
+        EXPECT_EQ(5, feed(detector, field, 500, timestamp, event)) << "Five rotations back";
+        EXPECT_EQ(-1, event.direction) << "Backward";
+        EXPECT_EQ(turned - 5, detector.getCount()) << "Net count went down";
+        EXPECT_EQ(pulses + 5, detector.getPulses()) << "Pulses keep going up";
+    }
+
+    TEST(PulseDetectorTest, pulseDetectorQuietTest) {
+        QmcSimulator simulator;
+        const MagnetoSensorQmc sensor(&simulator);
+        PulseDetector detector(&sensor);
+        detector.begin();
+        PulseEvent event{};
+
+        // noise within the noise range doesn't count
+        std::mt19937 generator(3);
+        std::uniform_int_distribution<int> noise(-30, 30);
+        for (unsigned long i = 0; i < 5000; i++) {
+            const SensorData sample{
+                static_cast<short>(200 + noise(generator)), static_cast<short>(-100 + noise(generator)), 50
+            };
+            EXPECT_FALSE(detector.update(sample, i, event)) << "No pulse at " << i;
+        }
+
+        // a slow rotation needs a slower decay
+        detector.configureDecay(13);
+        detector.begin();
+        RotatingField slow(3000);
+        unsigned long timestamp = 0;
+        feed(detector, slow, 4500, timestamp, event);
+        EXPECT_EQ(3, feed(detector, slow, 9000, timestamp, event)) << "Three slow rotations";
+
+        // saturated samples are skipped
+        EXPECT_FALSE(detector.update({ SHRT_MIN, 0, 0 }, timestamp, event)) << "Saturated";
+        EXPECT_EQ(0, detector.getPrimaryAxis()) << "Still tracking x";
+    }
+
+    TEST(PulseDetectorTest, pulseDetectorGainChangeTest) {
+        QmcSimulator simulator;
+        const MagnetoSensorQmc sensor(&simulator);
+        PulseDetector detector(&sensor);
+        detector.begin();
+        RotatingField field(100);
+        PulseEvent event{};
+        unsigned long timestamp = 0;
+        feed(detector, field, 250, timestamp, event);
+        const unsigned long pulses = detector.getPulses();
+
+        // after a gain change, the envelopes start over
+        TimedSample sample{ { 30000, 30000, 30000 }, timestamp, SampleGainChanged | SampleOldGain };
+        EXPECT_FALSE(detector.update(sample, event)) << "Old gain sample skipped";
+        sample.flags = SampleOldGain;
+        EXPECT_FALSE(detector.update(sample, event)) << "Second old gain sample skipped";
+        int events = 0;
+        for (int i = 0; i < 1000; i++) {
+            sample = { field.next(), timestamp += 20000, 0 };
+            if (detector.update(sample, event)) events++;
+        }
+        EXPECT_LE(9, events) << "Counting again after the gain change";
+        EXPECT_EQ(pulses + events, detector.getPulses()) << "Pulses added up";
+    }
+}
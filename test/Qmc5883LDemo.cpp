@@ -18,15 +18,17 @@
 
 #include <Wire.h>
 #include <MagnetoSensorQmc.h>
+#include <SampleScheduler.h>
 
 using namespace MagnetoSensors;
 
 namespace Qmc5883LDemo {
 
     constexpr uint8_t PowerPin = 15;
-    constexpr int SampleTime = 10000;
+    constexpr unsigned long SampleTime = 10000;
 
     MagnetoSensorQmc sensor(&Wire);
+    SampleScheduler scheduler(&sensor, SampleTime);
 
     void printSampleWithDuration(const SensorData& sample, const unsigned long sampleDuration) {
         Serial.printf("x:%d, y:%d, z:%d", sample.x, sample.y, sample.z);
@@ -34,14 +36,14 @@ namespace Qmc5883LDemo {
     }
 
     void readSample(const bool print = true) {
-        const unsigned long startTime = micros();
         SensorData sample;
+        scheduler.waitForSlot();
+        const unsigned long startTime = micros();
         sensor.read(sample);
         const auto sampleDuration = micros() - startTime;
         if (print) {
             printSampleWithDuration(sample, sampleDuration);
         }
-        while (micros() - startTime < SampleTime);
     }
 
     void setup() {
@@ -58,6 +60,7 @@ namespace Qmc5883LDemo {
         sensor.configureOverSampling(QmcSampling512);
         sensor.begin();
 
+        scheduler.begin();
         // Get the sensor started. The first few results might not be reliable
         for (int i = 0; i < 5; i++) {
             readSample(false);
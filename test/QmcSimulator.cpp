@@ -0,0 +1,117 @@
+// Copyright 2024 Rik Essenius
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+// except in compliance with the License. You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and limitations under the License.
+
+#include "QmcSimulator.h"
+#include <climits>
+#include <cmath>
+
+namespace MagnetoSensorsTest {
+    namespace {
+        constexpr byte DataFirst = 0x00;
+        constexpr byte DataLast = 0x05;
+        constexpr byte Status = 0x06;
+        constexpr byte Control1 = 0x09;
+        constexpr byte Control2 = 0x0a;
+        constexpr byte ChipId = 0x0d;
+        constexpr byte DataReady = 0x01;
+        constexpr byte Overflow = 0x02;
+        constexpr byte DataSkipped = 0x04;
+        constexpr byte ModeMask = 0x03;
+        constexpr byte ModeContinuous = 0x01;
+        constexpr byte SoftReset = 0x80;
+        constexpr byte RollOver = 0x40;
+        constexpr unsigned long Rates[] = { 10, 50, 100, 200 };
+        constexpr double Gains[] = { 12000, 3000 };
+        constexpr double Ranges[] = { 2, 8 };
+    }
+
+    QmcSimulator::QmcSimulator() : I2cSimulator(0x0D) {
+        reset();
+    }
+
+    unsigned long QmcSimulator::getPeriod() const {
+        constexpr unsigned long MicrosPerSecond = 1000000UL;
+        return MicrosPerSecond / Rates[(_registers[Control1] >> 2) & 0x03];
+    }
+
+    bool QmcSimulator::isContinuous() const {
+        return (_registers[Control1] & ModeMask) == ModeContinuous;
+    }
+
+    void QmcSimulator::latch() {
+        const byte rangeIndex = (_registers[Control1] >> 4) & 0x01;
+        const double gain = Gains[rangeIndex];
+        bool overflow = false;
+        for (int axis = 0; axis < 3; axis++) {
+            if (std::fabs(_field[axis]) > Ranges[rangeIndex]) overflow = true;
+            long counts = std::lround(_field[axis] * gain) + noise(_noise);
+            if (counts > SHRT_MAX) counts = SHRT_MAX;
+            if (counts < SHRT_MIN) counts = SHRT_MIN;
+            // LSB first
+            _registers[DataFirst + 2 * axis] = static_cast<byte>(counts & 0xff);
+            _registers[DataFirst + 2 * axis + 1] = static_cast<byte>((counts >> 8) & 0xff);
+        }
+        byte status = _registers[Status];
+        if ((status & DataReady) != 0) status |= DataSkipped;
+        status |= DataReady;
+        if (overflow) status |= Overflow;
+        else status = static_cast<byte>(status & ~Overflow);
+        _registers[Status] = status;
+        _measurements++;
+    }
+
+    byte QmcSimulator::nextPointer(const byte current) const {
+        if (current == Status && (_registers[Control2] & RollOver) != 0) return DataFirst;
+        return I2cSimulator::nextPointer(current);
+    }
+
+    byte QmcSimulator::readRegister(const byte sensorRegister) {
+        const byte value = I2cSimulator::readRegister(sensorRegister);
+        if (sensorRegister <= DataLast) {
+            _registers[Status] = static_cast<byte>(_registers[Status] & ~(DataReady | DataSkipped));
+        }
+        return value;
+    }
+
+    void QmcSimulator::reset() {
+        for (auto& value : _registers) value = 0;
+        _registers[0x0c] = 0x01;
+        _registers[ChipId] = 0xff;
+    }
+
+    void QmcSimulator::setField(const double x, const double y, const double z) {
+        _field[0] = x;
+        _field[1] = y;
+        _field[2] = z;
+    }
+
+    void QmcSimulator::update() {
+        if (!isContinuous()) return;
+        while (static_cast<long>(now() - _nextSample) >= 0) {
+            latch();
+            _nextSample += getPeriod();
+        }
+    }
+
+    void QmcSimulator::writeRegister(const byte sensorRegister, const byte value) {
+        if (sensorRegister == Control2 && (value & SoftReset) != 0) {
+            reset();
+            return;
+        }
+        // data, status and chip ID are read only
+        if (sensorRegister <= Status || sensorRegister == ChipId) return;
+        const bool wasContinuous = isContinuous();
+        I2cSimulator::writeRegister(sensorRegister, value);
+        if (sensorRegister == Control1 && isContinuous() && !wasContinuous) {
+            _nextSample = now() + getPeriod();
+        }
+    }
+}
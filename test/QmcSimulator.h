@@ -0,0 +1,58 @@
+// Copyright 2024 Rik Essenius
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+// except in compliance with the License. You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and limitations under the License.
+
+// Simulates the QMC5883L registers. What we model:
+// * continuous mode at the configured output data rate; the first sample comes one period after starting.
+//   The datasheet gives no conversion time per oversampling setting, so that doesn't change the timing.
+// * gain per range; OVL when the field is out of range, with the outputs clipping at the 16 bit limits
+// * DRDY set when a sample is latched; DOR set when a sample was latched before the previous one was read.
+//   Reading a data register clears both right away, so a status read after the data in the same burst
+//   no longer shows them. The datasheet doesn't promise anything else.
+// * soft reset, pointer roll-over (ROL_PNT) and the chip ID register
+
+#ifndef HEADER_QMC_SIMULATOR
+#define HEADER_QMC_SIMULATOR
+
+#include "I2cSimulator.h"
+
+namespace MagnetoSensorsTest {
+    class QmcSimulator : public I2cSimulator {
+    public:
+        QmcSimulator();
+
+        byte getRegister(const byte sensorRegister) const { return _registers[sensorRegister]; }
+        unsigned long getMeasurements() const { return _measurements; }
+        unsigned long getPeriod() const;
+
+        // the field the sensor sees, in Gauss
+        void setField(double x, double y, double z);
+
+        // noise in counts, added to each axis
+        void setNoise(int amplitude) { _noise = amplitude; }
+
+    protected:
+        byte nextPointer(byte current) const override;
+        byte readRegister(byte sensorRegister) override;
+        void update() override;
+        void writeRegister(byte sensorRegister, byte value) override;
+
+    private:
+        bool isContinuous() const;
+        void latch();
+        void reset();
+
+        double _field[3] {};
+        int _noise = 0;
+        unsigned long _nextSample = 0;
+        unsigned long _measurements = 0;
+    };
+}
+#endif
@@ -0,0 +1,94 @@
+// Copyright 2024 Rik Essenius
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+// except in compliance with the License. You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and limitations under the License.
+
+#include "gtest/gtest.h"
+#include <thread>
+#include <Wire.h>
+#include <MagnetoSensorQmc.h>
+#include <SampleRing.h>
+
+namespace MagnetoSensorsTest {
+    using namespace MagnetoSensors;
+
+    TEST(SampleRingTest, pushPopTest) {
+        SampleRing<4> ring;
+        EXPECT_EQ(4u, ring.capacity()) << "Capacity ok";
+        EXPECT_TRUE(ring.empty()) << "Empty at start";
+        TimedSample sample{};
+        EXPECT_FALSE(ring.pop(sample)) << "Nothing to pop";
+        for (short i = 0; i < 4; i++) {
+            EXPECT_TRUE(ring.push(SensorData{ i, 1, 2 }, 100 + i)) << "Push " << i;
+        }
+        EXPECT_EQ(4u, ring.size()) << "Full";
+        EXPECT_FALSE(ring.push(SensorData{ 9, 9, 9 }, 200)) << "Push on full ring fails";
+        EXPECT_EQ(1u, ring.getOverruns()) << "Overrun counted";
+        EXPECT_TRUE(ring.pop(sample)) << "Pop";
+        EXPECT_EQ(0, sample.data.x) << "First in, first out";
+        EXPECT_EQ(100u, sample.timestamp) << "Timestamp kept";
+        EXPECT_TRUE(ring.push(SensorData{ 4, 1, 2 }, 104)) << "Room again, wraps around";
+
+        TimedSample samples[8]{};
+        EXPECT_EQ(2u, ring.drain(samples, 2)) << "Drained up to the maximum";
+        EXPECT_EQ(1, samples[0].data.x) << "Drain 0 ok";
+        EXPECT_EQ(2, samples[1].data.x) << "Drain 1 ok";
+        EXPECT_EQ(2u, ring.drain(samples, 8)) << "Drained the rest";
+        EXPECT_EQ(3, samples[0].data.x) << "Drain 2 ok";
+        EXPECT_EQ(4, samples[1].data.x) << "Drain 3 (wrapped) ok";
+        EXPECT_TRUE(ring.empty()) << "Empty again";
+    }
+
+    TEST(SampleRingTest, producerConsumerTest) {
+        constexpr short SampleCount = 30000;
+        SampleRing<64> ring;
+        std::thread producer([&ring] {
+            for (short i = 0; i < SampleCount; i++) {
+                while (!ring.push(SensorData{ i, static_cast<short>(-i), 0 }, i)) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+        short expected = 0;
+        bool ordered = true;
+        TimedSample samples[16];
+        while (expected < SampleCount) {
+            const size_t count = ring.drain(samples, 16);
+            for (size_t i = 0; i < count; i++) {
+                ordered &= samples[i].data.x == expected && samples[i].data.y == -expected && samples[i].timestamp == static_cast<unsigned long>(expected);
+                expected++;
+            }
+            if (count == 0) std::this_thread::yield();
+        }
+        producer.join();
+        EXPECT_TRUE(ordered) << "All samples arrived intact and in order";
+        EXPECT_TRUE(ring.empty()) << "Nothing left";
+    }
+
+    TEST(SampleRingTest, samplerTest) {
+        MagnetoSensorQmc sensor(&Wire);
+        Wire.begin();
+        sensor.begin();
+        SampleRing<2> ring;
+        Sampler<2> sampler(&sensor, &ring);
+        // status 0x01 means data ready
+        Wire.setFlatline(true, 0x01);
+        EXPECT_TRUE(sampler.sample()) << "First sample";
+        EXPECT_TRUE(sampler.sample()) << "Second sample";
+        EXPECT_FALSE(sampler.sample()) << "Ring full";
+        EXPECT_EQ(1u, ring.getOverruns()) << "Overrun";
+        TimedSample sample{};
+        EXPECT_TRUE(ring.pop(sample)) << "Pop";
+        EXPECT_EQ(0x0101, sample.data.z) << "Sample data came from the sensor";
+        Wire.setFlatline(true, 0x00);
+        EXPECT_FALSE(sampler.sample()) << "No data ready";
+        EXPECT_EQ(1u, ring.size()) << "Nothing pushed";
+        Wire.setFlatline(false, 0);
+    }
+}
@@ -0,0 +1,78 @@
+// Copyright 2024 Rik Essenius
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+// except in compliance with the License. You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and limitations under the License.
+
+#include "gtest/gtest.h"
+#include <MagnetoSensorNull.h>
+#include <SampleScheduler.h>
+
+namespace MagnetoSensorsTest {
+    using namespace MagnetoSensors;
+
+    TEST(SampleSchedulerTest, fixedRateTest) {
+        setRealTime(false);
+        MagnetoSensorNull sensor;
+        constexpr unsigned long Period = 3000;
+        SampleScheduler scheduler(&sensor, Period);
+        scheduler.begin();
+        EXPECT_TRUE(scheduler.isDue()) << "First slot is due right away";
+        const unsigned long first = scheduler.waitForSlot();
+        EXPECT_FALSE(scheduler.isDue()) << "Next slot not due yet";
+        unsigned long previous = first;
+        for (int i = 1; i < 5; i++) {
+            const unsigned long slot = scheduler.waitForSlot();
+            EXPECT_EQ(Period, slot - previous) << "Slots are a period apart: " << i;
+            EXPECT_LE(static_cast<long>(slot - micros()), 0) << "Slot not served early: " << i;
+            previous = slot;
+        }
+        EXPECT_EQ(5u, scheduler.getSlots()) << "5 slots";
+        EXPECT_EQ(0u, scheduler.getMissedSlots()) << "None missed";
+        EXPECT_LE(scheduler.getAverageJitter(), scheduler.getMaxJitter()) << "Average below max";
+        EXPECT_GT(10u, scheduler.getMaxJitter()) << "Slots served on time";
+        SensorData sample{ 1, 2, 3 };
+        EXPECT_FALSE(scheduler.read(sample)) << "Null sensor read fails";
+        EXPECT_EQ(0, sample.x) << "but the read was done";
+    }
+
+    TEST(SampleSchedulerTest, skipOnOverrunTest) {
+        setRealTime(false);
+        MagnetoSensorNull sensor;
+        constexpr unsigned long Period = 2000;
+        SampleScheduler scheduler(&sensor, Period, OverrunSkip);
+        scheduler.begin();
+        const unsigned long first = scheduler.waitForSlot();
+        // overrun by well over two periods
+        delay(7);
+        const unsigned long late = scheduler.waitForSlot();
+        EXPECT_EQ(first + Period, late) << "Late slot is served";
+        EXPECT_EQ(2u, scheduler.getMissedSlots()) << "Slots skipped";
+        EXPECT_GE(scheduler.getMaxJitter(), 2 * Period) << "Jitter recorded";
+        const unsigned long next = scheduler.waitForSlot();
+        EXPECT_EQ(0u, (next - first) % Period) << "Still on the original grid";
+        EXPECT_GT(next - late, Period) << "Missed slots were skipped";
+    }
+
+    TEST(SampleSchedulerTest, catchUpOnOverrunTest) {
+        setRealTime(false);
+        MagnetoSensorNull sensor;
+        constexpr unsigned long Period = 2000;
+        SampleScheduler scheduler(&sensor, Period, OverrunCatchUp);
+        scheduler.begin();
+        const unsigned long first = scheduler.waitForSlot();
+        delay(5);
+        EXPECT_EQ(first + Period, scheduler.waitForSlot()) << "Late slot";
+        EXPECT_TRUE(scheduler.isDue()) << "Next one is due right away";
+        EXPECT_EQ(first + 2 * Period, scheduler.waitForSlot()) << "Catching up";
+        EXPECT_EQ(1u, scheduler.getMissedSlots()) << "One slot was served more than a period late";
+        scheduler.resetStatistics();
+        EXPECT_EQ(0u, scheduler.getSlots()) << "Statistics reset";
+        EXPECT_EQ(0u, scheduler.getAverageJitter()) << "No slots, no jitter";
+    }
+}
@@ -0,0 +1,99 @@
+// Copyright 2024 Rik Essenius
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+// except in compliance with the License. You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and limitations under the License.
+
+#include "gtest/gtest.h"
+#include <climits>
+#include <vector>
+#include <SensorBlock.h>
+
+namespace MagnetoSensorsTest {
+    using MagnetoSensors::AxisSummary;
+    using MagnetoSensors::BlockKernels;
+    using MagnetoSensors::SensorBlock;
+    using MagnetoSensors::SensorData;
+
+    namespace {
+        AxisSummary reference(const std::vector<short>& values) {
+            AxisSummary summary{ SHRT_MAX, SHRT_MIN, 0, 0 };
+            for (const auto value : values) {
+                summary.min = std::min(summary.min, value);
+                summary.max = std::max(summary.max, value);
+                summary.sum += value;
+                summary.sumOfSquares += static_cast<uint64_t>(static_cast<int64_t>(value) * value);
+            }
+            return summary;
+        }
+    }
+
+    TEST(SensorBlockTest, sensorBlockTransposeTest) {
+        SensorBlock<32> block;
+        EXPECT_EQ(32u, block.capacity()) << "Capacity ok";
+        EXPECT_TRUE(block.empty()) << "Empty at start";
+        SensorData samples[40];
+        for (short i = 0; i < 40; i++) samples[i] = { i, static_cast<short>(-i), static_cast<short>(2 * i) };
+        EXPECT_EQ(32u, block.load(samples, 40)) << "Loaded up to capacity";
+        EXPECT_TRUE(block.full()) << "Full";
+        EXPECT_FALSE(block.push(samples[0])) << "Can't push on a full block";
+        EXPECT_EQ(-7, block.getY()[7]) << "Y transposed";
+        EXPECT_EQ(samples[31], block.get(31)) << "Get ok";
+        SensorData out[32]{};
+        block.store(out);
+        EXPECT_EQ(samples[17], out[17]) << "Round trip ok";
+
+        block.clear();
+        EXPECT_TRUE(block.push(samples[5])) << "Pushed";
+        EXPECT_EQ(1u, block.size()) << "One sample";
+        EXPECT_EQ(samples[5], block.get(0)) << "Pushed sample ok";
+    }
+
+    TEST(SensorBlockTest, sensorBlockSummaryTest) {
+        SensorBlock<64> block;
+        EXPECT_EQ(0, block.summarize().x.max) << "Empty block summarizes to zeros";
+        // 61 samples, so we also use the scalar tail
+        for (int i = 0; i < 61; i++) {
+            block.push({ static_cast<short>(i * 1000 - 30000), static_cast<short>(7), static_cast<short>(i % 2 == 0 ? SHRT_MAX : -SHRT_MAX) });
+        }
+        const auto summary = block.summarize();
+        EXPECT_EQ(61u, summary.count) << "Count ok";
+        EXPECT_EQ(-30000, summary.x.min) << "Min X";
+        EXPECT_EQ(30000, summary.x.max) << "Max X";
+        EXPECT_EQ(0, summary.x.sum) << "Sum X";
+        EXPECT_EQ(7, summary.y.min) << "Min Y";
+        EXPECT_EQ(427, summary.y.sum) << "Sum Y";
+        EXPECT_EQ(49ull * 61, summary.y.sumOfSquares) << "Sum of squares Y";
+        EXPECT_EQ(61ull * SHRT_MAX * SHRT_MAX, summary.z.sumOfSquares) << "Sum of squares Z";
+        EXPECT_FALSE(block.isSaturated()) << "Not saturated";
+        block.push({ 0, 0, SHRT_MIN });
+        EXPECT_TRUE(block.isSaturated()) << "Saturated sample in the tail";
+    }
+
+    TEST(SensorBlockTest, blockKernelsTest) {
+        // large enough to need several flushes of the vector sums, and extreme values everywhere
+        std::vector<short> values(300007);
+        for (size_t i = 0; i < values.size(); i++) {
+            values[i] = static_cast<short>(i % 3 == 0 ? SHRT_MIN : i % 3 == 1 ? SHRT_MAX : static_cast<short>(i * 2));
+        }
+        const auto expected = reference(values);
+        // also from an unaligned start
+        for (size_t offset = 0; offset < 2; offset++) {
+            const std::vector<short> part(values.begin() + static_cast<long>(offset), values.end());
+            const auto wanted = offset == 0 ? expected : reference(part);
+            const auto actual = BlockKernels::summarize(part.data(), part.size());
+            EXPECT_EQ(wanted.min, actual.min) << "Min, offset " << offset;
+            EXPECT_EQ(wanted.max, actual.max) << "Max, offset " << offset;
+            EXPECT_EQ(wanted.sum, actual.sum) << "Sum, offset " << offset;
+            EXPECT_EQ(wanted.sumOfSquares, actual.sumOfSquares) << "Sum of squares, offset " << offset;
+        }
+        EXPECT_TRUE(BlockKernels::contains(values.data(), values.size(), SHRT_MIN)) << "Contains SHRT_MIN";
+        EXPECT_FALSE(BlockKernels::contains(values.data() + 1, 2, SHRT_MIN)) << "Not in a short stretch";
+        EXPECT_FALSE(BlockKernels::contains(values.data(), values.size(), 1)) << "Doesn't contain 1";
+    }
+}
@@ -0,0 +1,86 @@
+// Copyright 2024 Rik Essenius
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+// except in compliance with the License. You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and limitations under the License.
+
+#include "gtest/gtest.h"
+#include <SensorDetector.h>
+#include "HmcSimulator.h"
+#include "QmcSimulator.h"
+
+namespace MagnetoSensorsTest {
+    using namespace MagnetoSensors;
+
+    namespace {
+        // answers on the HMC address, but is something else
+        class ForeignChip final : public HmcSimulator {
+        protected:
+            byte readRegister(const byte sensorRegister) override {
+                constexpr byte IdFirst = 10;
+                return sensorRegister >= IdFirst ? 0 : HmcSimulator::readRegister(sensorRegister);
+            }
+        };
+    }
+
+    TEST(SensorDetectorTest, sensorDetectorTest) {
+        setRealTime(false);
+        HmcSimulator hmcBus;
+        hmcBus.setField(0.1, 0.2, 0.3);
+        QmcSimulator qmcBus;
+        qmcBus.setField(0.1, 0.2, 0.3);
+        TwoWire* wires[] = { &hmcBus, &qmcBus };
+        MagnetoSensor* sensors[2] {};
+        SensorDetector detector;
+        EXPECT_EQ(2, detector.detect(wires, 2, sensors)) << "Found both";
+        EXPECT_EQ(SensorHmc, detector.getType(0)) << "HMC on the first bus";
+        EXPECT_EQ(SensorQmc, detector.getType(1)) << "QMC on the second bus";
+        EXPECT_EQ(detector.getHmc(0), sensors[0]) << "HMC driver";
+        EXPECT_EQ(nullptr, detector.getQmc(0)) << "Not a QMC";
+        EXPECT_EQ(detector.getQmc(1), sensors[1]) << "QMC driver";
+        EXPECT_EQ(&hmcBus, sensors[0]->getWire()) << "Driver on the right bus";
+        EXPECT_EQ(HmcRange4_7, hmcBus.getRegister(HmcControlB)) << "HMC got its begin()";
+
+        // the first HMC sample still has the power-on gain
+        SensorData samples[2] {};
+        EXPECT_EQ(2u, sensors[0]->readBatch(samples, 2)) << "HMC reads";
+        EXPECT_EQ(39, samples[1].x) << "HMC sample";
+        SensorData sample{};
+        EXPECT_EQ(1u, sensors[1]->readBatch(&sample, 1)) << "QMC reads";
+        EXPECT_EQ(300, sample.x) << "QMC sample";
+
+        // reconfigure through the typed driver
+        detector.getQmc(1)->configureRange(QmcRange2G);
+        EXPECT_TRUE(detector.getQmc(1)->begin()) << "Reconfigured";
+        EXPECT_EQ(QmcRange2G, detector.getQmc(1)->getRange()) << "New range";
+    }
+
+    TEST(SensorDetectorTest, sensorDetectorMissingTest) {
+        setRealTime(false);
+        HmcSimulator missing;
+        missing.setConnected(false);
+        SensorDetector detector;
+        const unsigned long start = micros();
+        MagnetoSensor* sensor = detector.detect(0, &missing);
+        EXPECT_FALSE(sensor->isReal()) << "Null sensor";
+        EXPECT_EQ(SensorNone, detector.getType(0)) << "Nothing found";
+        EXPECT_EQ(sensor, detector.getSensor(0)) << "Slot holds the null sensor";
+        EXPECT_EQ(2u, missing.getTransactions()) << "Only the two address pings";
+        EXPECT_GT(100u, micros() - start) << "No waiting";
+
+        ForeignChip foreign;
+        EXPECT_FALSE(detector.detect(1, &foreign)->isReal()) << "Answers, but not with the right ID";
+        EXPECT_EQ(0x20, foreign.getRegister(HmcControlB)) << "No begin() on an unknown chip";
+        EXPECT_FALSE(detector.detect(SensorDetector::MaxBuses, &foreign)->isReal()) << "Slot out of range";
+
+        // detecting again replaces the driver in the slot
+        missing.setConnected(true);
+        EXPECT_TRUE(detector.detect(0, &missing)->isReal()) << "Found after connecting";
+        EXPECT_NE(nullptr, detector.getHmc(0)) << "HMC now";
+    }
+}
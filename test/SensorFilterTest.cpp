@@ -0,0 +1,147 @@
+// Copyright 2024 Rik Essenius
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+// except in compliance with the License. You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and limitations under the License.
+
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <cmath>
+#include <MagnetoSensorHmc.h>
+#include <MagnetoSensorQmc.h>
+#include <SensorFilter.h>
+
+namespace MagnetoSensorsTest {
+    using namespace MagnetoSensors;
+
+    namespace {
+        constexpr double Pi = 3.14159265358979;
+
+        short sine(const double amplitude, const double frequency, const double sampleRate, const int index) {
+            return static_cast<short>(std::lround(amplitude * std::sin(2 * Pi * frequency * index / sampleRate)));
+        }
+
+        // the peak of the x axis over the second half of count samples, so after the filter settled
+        template <typename Filter>
+        int settledPeak(Filter& filter, const double amplitude, const double frequency, const double sampleRate,
+                        const short offset = 0, const int count = 400) {
+            int peak = 0;
+            for (int i = 0; i < count; i++) {
+                const auto x = static_cast<short>(offset + sine(amplitude, frequency, sampleRate, i));
+                const auto output = filter.apply(SensorData{ x, 0, 0 });
+                if (i >= count / 2 && std::abs(output.x) > peak) peak = std::abs(output.x);
+            }
+            return peak;
+        }
+    }
+
+    TEST(SensorFilterTest, lowPassTest) {
+        const auto sampleRate = MagnetoSensorQmc::getSampleRate(QmcRate100Hz);
+        LowPassFilter filter;
+        filter.configure(5, sampleRate);
+        EXPECT_EQ(SensorData({ 1000, -2000, 30000 }), filter.apply({ 1000, -2000, 30000 })) << "First sample primes";
+        for (int i = 0; i < 10; i++) filter.apply({ 1000, -2000, 30000 });
+        EXPECT_EQ(SensorData({ 1000, -2000, 30000 }), filter.apply({ 1000, -2000, 30000 })) << "DC gain is 1";
+
+        // a step settles without much overshoot (Butterworth has about 4%)
+        SensorData output{};
+        short highest = 0;
+        for (int i = 0; i < 100; i++) {
+            output = filter.apply({ 2000, -2000, 30000 });
+            if (output.x > highest) highest = output.x;
+        }
+        EXPECT_EQ(SensorData({ 2000, -2000, 30000 }), output) << "Step settled";
+        EXPECT_GT(2050, highest) << "Overshoot below 5%";
+
+        filter.reset();
+        EXPECT_GT(50, settledPeak(filter, 1000, 40, sampleRate)) << "40 Hz attenuated to below 5%";
+        filter.reset();
+        EXPECT_NEAR(1000, settledPeak(filter, 1000, 1, sampleRate), 20) << "1 Hz passes";
+        filter.reset();
+        EXPECT_NEAR(707, settledPeak(filter, 1000, 5, sampleRate), 20) << "-3 dB at the cutoff";
+
+        // a low cutoff for the slowest QMC rate still has an exact DC gain
+        filter.configure(0.05, MagnetoSensorQmc::getSampleRate(QmcRate10Hz));
+        for (int i = 0; i < 10; i++) output = filter.apply({ -32767, 32767, 12345 });
+        EXPECT_EQ(SensorData({ -32767, 32767, 12345 }), output) << "Full scale DC passes";
+    }
+
+    TEST(SensorFilterTest, movingAverageTest) {
+        MovingAverage<4> average;
+        EXPECT_EQ(SensorData({ 4, -4, 0 }), average.apply({ 4, -4, 0 })) << "First";
+        EXPECT_EQ(SensorData({ 6, -6, 1 }), average.apply({ 8, -8, 1 })) << "Average of two (0.5 rounds away from 0)";
+        EXPECT_EQ(SensorData({ 6, -6, 1 }), average.apply({ 6, -6, 1 })) << "Average of three";
+        EXPECT_EQ(SensorData({ 7, -7, 1 }), average.apply({ 10, -10, 2 })) << "Full";
+        EXPECT_EQ(SensorData({ 9, -9, 2 }), average.apply({ 12, -12, 4 })) << "First value dropped";
+        EXPECT_EQ(SensorData({ SHRT_MIN, -9, 2 }), average.apply({ SHRT_MIN, -9, 2 })) << "Saturated axis passes";
+        EXPECT_EQ(SensorData({ 12, -10, 3 }), average.apply({ 20, -9, 2 })) << "Saturated value not in the average";
+
+        average.reset();
+        EXPECT_EQ(SensorData({ 100, 100, 100 }), average.apply({ 100, 100, 100 })) << "Reset";
+
+        MovingAverage<64> longAverage;
+        SensorData output{};
+        for (int i = 0; i < 1000; i++) output = longAverage.apply({ SHRT_MAX, -SHRT_MAX, static_cast<short>(i % 2) });
+        EXPECT_EQ(SensorData({ SHRT_MAX, -SHRT_MAX, 1 }), output) << "No overflow, and 0.5 rounds up";
+    }
+
+    TEST(SensorFilterTest, dcBlockerTest) {
+        const auto sampleRate = MagnetoSensorQmc::getSampleRate(QmcRate50Hz);
+        DcBlocker blocker;
+        blocker.configure(0.5, sampleRate);
+        EXPECT_EQ(SensorData({ 0, 0, 0 }), blocker.apply({ 3000, -2000, 500 })) << "First sample is all DC";
+
+        // the earth's field goes, the pattern stays
+        EXPECT_NEAR(1000, settledPeak(blocker, 1000, 5, sampleRate, 3000), 30) << "5 Hz passes";
+        SensorData output{};
+        for (int i = 0; i < 500; i++) output = blocker.apply({ 3000, -2000, 500 });
+        EXPECT_GE(1, std::abs(output.x)) << "Offset removed";
+        blocker.reset();
+
+        // a step in the field decays
+        blocker.apply({ 0, 0, 0 });
+        output = blocker.apply({ 1000, 0, 0 });
+        EXPECT_EQ(1000, output.x) << "Step passes at first";
+        for (int i = 0; i < 200; i++) output = blocker.apply({ 1000, 0, 0 });
+        EXPECT_GT(50, output.x) << "Step decayed";
+        EXPECT_EQ(SHRT_MIN, blocker.apply({ SHRT_MIN, 0, 0 }).x) << "Saturated axis passes";
+    }
+
+    TEST(SensorFilterTest, blockTest) {
+        const auto sampleRate = MagnetoSensorHmc::getSampleRate(HmcRate75);
+        EXPECT_DOUBLE_EQ(75.0, sampleRate) << "HMC sample rate";
+        EXPECT_DOUBLE_EQ(0.75, MagnetoSensorHmc::getSampleRate(HmcRate0_75)) << "Slowest HMC sample rate";
+
+        constexpr size_t Count = 100;
+        SensorData block[Count];
+        for (size_t i = 0; i < Count; i++) {
+            block[i] = { sine(1500, 7, sampleRate, i), sine(800, 3, sampleRate, i), static_cast<short>(i * 10) };
+        }
+        block[20].y = SHRT_MIN;
+        SensorData stream[Count];
+        std::copy(block, block + Count, stream);
+
+        LowPassFilter lowPass;
+        lowPass.configure(10, sampleRate);
+        DcBlocker dcBlocker;
+        dcBlocker.configure(0.2, sampleRate);
+        MovingAverage<8> average;
+        lowPass.apply(block, Count);
+        dcBlocker.apply(block, Count);
+        average.apply(block, Count);
+
+        lowPass.reset();
+        dcBlocker.reset();
+        average.reset();
+        for (size_t i = 0; i < Count; i++) {
+            stream[i] = average.apply(dcBlocker.apply(lowPass.apply(stream[i])));
+            ASSERT_EQ(stream[i], block[i]) << "Block and stream give the same result at " << i;
+        }
+        EXPECT_EQ(SHRT_MIN, block[20].y) << "Saturated axis passed through the chain";
+    }
+}
@@ -0,0 +1,140 @@
+// Copyright 2024 Rik Essenius
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+// except in compliance with the License. You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and limitations under the License.
+
+#include "gtest/gtest.h"
+#include <MagnetoSensorHmc.h>
+#include <MagnetoSensorQmc.h>
+#include <SensorGroup.h>
+#include "HmcSimulator.h"
+#include "QmcSimulator.h"
+
+namespace MagnetoSensorsTest {
+    using namespace MagnetoSensors;
+
+    namespace {
+        // a sensor without bus traffic that always has a sample
+        class ReadySensor final : public MagnetoSensor {
+        public:
+            explicit ReadySensor(TwoWire* wire) : MagnetoSensor(0, wire) {}
+            bool begin() override { return true; }
+            double getGain() const override { return 1.0; }
+            int getNoiseRange() const override { return 1; }
+            bool read(SensorData& sample) override {
+                sample = { 1, 2, 3 };
+                return true;
+            }
+            void softReset() override {}
+        };
+
+        // a sensor that takes a while to start the next sample, and remembers when it was collected
+        class SlowStartSensor final : public MagnetoSensor {
+        public:
+            explicit SlowStartSensor(TwoWire* wire) : MagnetoSensor(0, wire) {}
+            bool begin() override { return true; }
+            double getGain() const override { return 1.0; }
+            int getNoiseRange() const override { return 1; }
+            bool read(SensorData& sample) override {
+                sample = { 1, 2, 3 };
+                collectedAt = micros();
+                return true;
+            }
+            void softReset() override {}
+            void startSample() override { delay(2); }
+            unsigned long collectedAt = 0;
+        };
+    }
+
+    TEST(SensorGroupTest, sensorGroupPipelineTest) {
+        setRealTime(false);
+        HmcSimulator hmcBus;
+        hmcBus.setField(0.1, 0.2, 0.3);
+        MagnetoSensorHmc hmc(&hmcBus);
+        hmc.begin();
+        QmcSimulator qmcBus;
+        qmcBus.setField(0.1, 0.2, 0.3);
+        MagnetoSensorQmc qmc(&qmcBus);
+        qmc.configureRate(QmcRate200Hz);
+        qmc.begin();
+
+        SensorGroup group;
+        EXPECT_TRUE(group.add(&hmc)) << "HMC added";
+        EXPECT_TRUE(group.add(&qmc)) << "QMC added";
+        HmcSimulator thirdBus;
+        MagnetoSensorHmc third(&thirdBus);
+        EXPECT_FALSE(group.add(&third)) << "No third bus";
+        EXPECT_EQ(2, group.getSensorCount()) << "Two sensors";
+        EXPECT_EQ(2, group.getBusCount()) << "Two buses";
+        EXPECT_EQ(1, group.getBus(1)) << "QMC on the second bus";
+
+        group.begin();
+        unsigned long perSensor[2] {};
+        GroupSample samples[2];
+        const unsigned long start = micros();
+        while (micros() - start < 1000000UL) {
+            const size_t count = group.poll(samples, 2);
+            for (size_t i = 0; i < count; i++) perSensor[samples[i].sensor]++;
+            delay(1);
+        }
+        // the HMC conversion takes 6 ms, and with polling every ms we lose at most one ms per sample
+        EXPECT_LT(140u, perSensor[0]) << "HMC samples back to back";
+        // the simulated clock also moves with the bus traffic, so a bit more than 200
+        EXPECT_LE(199u, perSensor[1]) << "QMC samples at its rate";
+        EXPECT_EQ(perSensor[0], group.getSamples(0)) << "Samples counted on the first bus";
+        EXPECT_EQ(perSensor[1], group.getSamples(1)) << "Samples counted on the second bus";
+        EXPECT_NEAR(perSensor[0], group.getSamplesPerSecond(0), 2) << "Samples per second on the first bus";
+        EXPECT_LT(0u, group.getMisses(0)) << "Polled while converting";
+
+        group.resetStatistics();
+        EXPECT_EQ(0u, group.getSamples(0)) << "Statistics reset";
+        EXPECT_EQ(0.0, group.getSamplesPerSecond(1)) << "No samples yet";
+    }
+
+    TEST(SensorGroupTest, sensorGroupTimestampTest) {
+        setRealTime(false);
+        HmcSimulator bus;
+        SlowStartSensor sensor(&bus);
+        SensorGroup group;
+        EXPECT_TRUE(group.add(&sensor)) << "Added";
+        group.begin();
+        GroupSample sample{};
+        ASSERT_EQ(1u, group.poll(&sample, 1)) << "Got a sample";
+        EXPECT_GT(1000u, sample.timestamp - sensor.collectedAt) << "Timestamp taken before starting the next sample";
+    }
+
+    TEST(SensorGroupTest, sensorGroupRoundRobinTest) {
+        setRealTime(false);
+        HmcSimulator bus;
+        ReadySensor first(&bus);
+        ReadySensor second(&bus);
+        ReadySensor third(&bus);
+        SensorGroup group;
+        EXPECT_TRUE(group.add(&first)) << "First";
+        EXPECT_TRUE(group.add(&second)) << "Second";
+        EXPECT_TRUE(group.add(&third)) << "Third";
+        EXPECT_EQ(1, group.getBusCount()) << "All on the same bus";
+        group.begin();
+
+        // with room for one sample per poll, the sensors still get their turn
+        GroupSample sample{};
+        for (byte i = 0; i < 7; i++) {
+            ASSERT_EQ(1u, group.poll(&sample, 1)) << "One sample " << static_cast<int>(i);
+            EXPECT_EQ(i % 3, sample.sensor) << "Round robin " << static_cast<int>(i);
+        }
+        GroupSample samples[4];
+        EXPECT_EQ(3u, group.poll(samples, 4)) << "Each sensor visited once per poll";
+        EXPECT_EQ(1, samples[0].sensor) << "Continued where the previous poll stopped";
+        EXPECT_EQ(SensorData({ 1, 2, 3 }), samples[2].data) << "Data collected";
+        EXPECT_EQ(10u, group.getSamples(0)) << "All counted on the bus";
+
+        for (byte i = 0; i < SensorGroup::MaxSensors - 3; i++) EXPECT_TRUE(group.add(&first)) << "Room left";
+        EXPECT_FALSE(group.add(&first)) << "Group full";
+    }
+}
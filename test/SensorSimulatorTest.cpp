@@ -0,0 +1,400 @@
+// Copyright 2024 Rik Essenius
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+// except in compliance with the License. You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and limitations under the License.
+
+// Runs the real drivers against the register level simulators.
+
+#include "gtest/gtest.h"
+#include <climits>
+#include <MagnetoSensorHmc.h>
+#include <MagnetoSensorQmc.h>
+#include <SampleRing.h>
+#include "HmcSimulator.h"
+#include "QmcSimulator.h"
+
+namespace MagnetoSensorsTest {
+    using MagnetoSensors::HmcContinuous;
+    using MagnetoSensors::HmcControlA;
+    using MagnetoSensors::HmcControlB;
+    using MagnetoSensors::HmcData;
+    using MagnetoSensors::HmcLock;
+    using MagnetoSensors::HmcMode;
+    using MagnetoSensors::HmcRange0_88;
+    using MagnetoSensors::HmcRange2_5;
+    using MagnetoSensors::HmcRange4_0;
+    using MagnetoSensors::HmcRange4_7;
+    using MagnetoSensors::HmcRate75;
+    using MagnetoSensors::HmcReady;
+    using MagnetoSensors::HmcSampling4;
+    using MagnetoSensors::HmcSingle;
+    using MagnetoSensors::HmcStatus;
+    using MagnetoSensors::HmcTestFailed;
+    using MagnetoSensors::HmcTestNotRun;
+    using MagnetoSensors::HmcTestPassed;
+    using MagnetoSensors::HmcTestRunning;
+    using MagnetoSensors::MagnetoSensorHmc;
+    using MagnetoSensors::MagnetoSensorQmc;
+    using MagnetoSensors::SampleGainChanged;
+    using MagnetoSensors::SampleOldGain;
+    using MagnetoSensors::SampleRing;
+    using MagnetoSensors::Sampler;
+    using MagnetoSensors::SensorData;
+    using MagnetoSensors::TimedSample;
+    using MagnetoSensors::requestFrom;
+    using MagnetoSensors::writeRegister;
+
+    TEST(SensorSimulatorTest, hmcSelfTestTest) {
+        setRealTime(false);
+        HmcSimulator simulator;
+        MagnetoSensorHmc sensor(&simulator);
+        EXPECT_TRUE(sensor.isOn()) << "Simulator acknowledges";
+        sensor.begin();
+        EXPECT_TRUE(sensor.handlePowerOn()) << "Self test passes";
+        EXPECT_EQ(0, simulator.getRegister(0) & 0x03) << "Bias switched off";
+        simulator.setConnected(false);
+        EXPECT_FALSE(sensor.isOn()) << "Disconnected simulator doesn't acknowledge";
+    }
+
+    TEST(SensorSimulatorTest, hmcFastBootTest) {
+        setRealTime(false);
+        HmcSimulator simulator;
+        simulator.setField(0.1, 0.1, 0.1);
+        MagnetoSensorHmc sensor(&simulator);
+        sensor.configureFastBoot(true);
+        auto start = micros();
+        sensor.begin();
+        EXPECT_TRUE(sensor.handlePowerOn()) << "Power on handled without waiting for the test";
+        EXPECT_GT(1000u, micros() - start) << "No waiting for measurements";
+        EXPECT_EQ(HmcTestRunning, sensor.getSelfTest()) << "Self test running";
+        EXPECT_EQ(1, simulator.getRegister(0) & 0x03) << "Positive bias on";
+
+        // sampling drives the test, and gets samples again once it is done
+        SensorData sample{};
+        start = micros();
+        int attempts = 0;
+        while (!sensor.read(sample)) {
+            ASSERT_GT(100, ++attempts) << "Test ends";
+            delay(1);
+        }
+        EXPECT_EQ(HmcTestPassed, sensor.getSelfTest()) << "Self test passed";
+        EXPECT_LE(3 * HmcSimulator::SingleMeasurementMicros, micros() - start) << "Three biased measurements";
+        EXPECT_EQ(0, simulator.getRegister(0) & 0x03) << "Bias switched off";
+        EXPECT_TRUE(sensor.hasOldGain()) << "First sample after the test flagged";
+        // read() in single mode returns the measurement started by the previous call
+        for (int i = 0; i < 3; i++) {
+            delay(7);
+            EXPECT_TRUE(sensor.read(sample)) << "Read " << i;
+        }
+        EXPECT_FALSE(sensor.hasOldGain()) << "Settled";
+        EXPECT_EQ(39, sample.x) << "Unbiased sample with the configured gain";
+
+        // split-phase reads get a new measurement after the test
+        sensor.startSample();
+        sensor.startSelfTest();
+        attempts = 0;
+        while (!sensor.tryCollect(sample)) {
+            ASSERT_GT(100, ++attempts) << "Collected after the test";
+            delay(1);
+        }
+        EXPECT_EQ(HmcTestPassed, sensor.getSelfTest()) << "Passed again";
+        EXPECT_TRUE(sensor.hasOldGain()) << "The measurement right after the test has the old gain";
+
+        // readBatch finishes a running test first
+        simulator.setField(2, 2, 2);
+        sensor.startSelfTest();
+        const auto transactions = simulator.getTransactions();
+        EXPECT_EQ(1u, sensor.readBatch(&sample, 1)) << "Got a sample after the test";
+        // per measurement about a status poll, a data read and the next start
+        EXPECT_GT(transactions + 30, simulator.getTransactions()) << "Waited for the measurements instead of polling the bus";
+        EXPECT_EQ(HmcTestFailed, sensor.getSelfTest()) << "Test fails in a strong field";
+
+        // a soft reset cancels a running test
+        sensor.startSelfTest();
+        sensor.softReset();
+        EXPECT_EQ(HmcTestNotRun, sensor.getSelfTest()) << "Cancelled";
+        EXPECT_EQ(0, simulator.getRegister(0) & 0x03) << "No bias after the reset";
+
+        // without fast boot, power on runs the blocking test
+        sensor.configureFastBoot(false);
+        simulator.setField(0.1, 0.1, 0.1);
+        EXPECT_TRUE(sensor.handlePowerOn()) << "Blocking test passes";
+        EXPECT_EQ(HmcTestPassed, sensor.getSelfTest()) << "Blocking test reports too";
+    }
+
+    TEST(SensorSimulatorTest, hmcReadTest) {
+        setRealTime(false);
+        HmcSimulator simulator;
+        simulator.setField(0.2, -0.1, 0.3);
+        MagnetoSensorHmc sensor(&simulator);
+        sensor.begin();
+        SensorData sample{};
+        EXPECT_EQ(1u, sensor.readBatch(&sample, 1)) << "Got a sample";
+        EXPECT_TRUE(sensor.hasOldGain()) << "The first sample after configuring still has the power-on gain";
+        EXPECT_EQ(218, sample.x) << "X with the power-on gain";
+        EXPECT_EQ(1u, sensor.readBatch(&sample, 1)) << "Got the next sample";
+        EXPECT_FALSE(sensor.hasOldGain()) << "The next sample has the configured gain";
+        EXPECT_EQ(78, sample.x) << "X is field times gain";
+        EXPECT_EQ(-39, sample.y) << "Y is field times gain";
+        EXPECT_EQ(117, sample.z) << "Z is field times gain";
+
+        simulator.setField(6, 0, 0);
+        EXPECT_EQ(1u, sensor.readBatch(&sample, 1)) << "Got the next sample";
+        EXPECT_EQ(1u, sensor.readBatch(&sample, 1)) << "Got a sample with the new field";
+        EXPECT_EQ(SHRT_MIN, sample.x) << "X saturated";
+        EXPECT_EQ(0, sample.y) << "Y not saturated";
+
+        simulator.setConnected(false);
+        EXPECT_EQ(0u, sensor.readBatch(&sample, 1)) << "No sample when disconnected";
+    }
+
+    TEST(SensorSimulatorTest, hmcReadyTest) {
+        setRealTime(false);
+        HmcSimulator simulator;
+        constexpr byte Address = 0x1E;
+        auto readStatus = [&simulator] {
+            requestFrom(&simulator, Address, HmcStatus, 1);
+            return simulator.read();
+        };
+        auto readData = [&simulator](const int count) {
+            requestFrom(&simulator, Address, HmcData, count);
+            for (int i = 0; i < count; i++) simulator.read();
+        };
+        writeRegister(&simulator, Address, HmcMode, HmcSingle);
+        EXPECT_EQ(0, readStatus() & HmcReady) << "No data yet";
+        simulator.advance(HmcSimulator::SingleMeasurementMicros);
+        EXPECT_EQ(0, readStatus() & HmcReady) << "RDY is low while the data is written";
+        simulator.advance(HmcSimulator::ReadyLowMicros);
+        EXPECT_EQ(HmcReady, readStatus()) << "RDY set";
+        readData(6);
+        EXPECT_EQ(HmcReady, readStatus()) << "Reading doesn't clear RDY";
+        writeRegister(&simulator, Address, HmcMode, HmcSingle);
+        EXPECT_EQ(HmcReady, readStatus()) << "RDY still reports the previous result while the next one converts";
+        readData(2);
+        EXPECT_EQ(HmcReady | HmcLock, readStatus()) << "Partial read locks the data registers";
+        simulator.advance(HmcSimulator::SingleMeasurementMicros + HmcSimulator::ReadyLowMicros);
+        EXPECT_EQ(1u, simulator.getMeasurements()) << "Locked data registers don't get the new result";
+        readData(6);
+        EXPECT_EQ(HmcReady, readStatus()) << "Reading all data registers unlocks them";
+    }
+
+    TEST(SensorSimulatorTest, hmcReadBatchTest) {
+        setRealTime(false);
+        HmcSimulator simulator;
+        simulator.setField(0.2, -0.1, 0.3);
+        simulator.setNoise(3);
+        MagnetoSensorHmc sensor(&simulator);
+        sensor.begin();
+        constexpr size_t Count = 5;
+        SensorData samples[Count]{};
+        auto measurements = simulator.getMeasurements();
+        EXPECT_EQ(Count, sensor.readBatch(samples, Count)) << "Single mode batch";
+        EXPECT_EQ(measurements + Count, simulator.getMeasurements()) << "One measurement per sample";
+
+        sensor.configureRate(HmcRate75, HmcContinuous);
+        sensor.softReset();
+        measurements = simulator.getMeasurements();
+        EXPECT_EQ(Count, sensor.readBatch(samples, Count)) << "Continuous mode batch";
+        EXPECT_EQ(measurements + Count, simulator.getMeasurements()) << "No duplicates and nothing skipped";
+    }
+
+    TEST(SensorSimulatorTest, hmcSplitPhaseTest) {
+        setRealTime(false);
+        HmcSimulator simulator;
+        simulator.setField(0.1, 0.1, 0.1);
+        MagnetoSensorHmc sensor(&simulator);
+        sensor.begin();
+        SensorData sample{};
+        EXPECT_FALSE(sensor.tryCollect(sample)) << "Nothing to collect before starting";
+        // the measurement that begin() started may still be running
+        delay(7);
+        sensor.startSample();
+        EXPECT_FALSE(sensor.tryCollect(sample)) << "RDY is still set from the last measurement, but this one isn't done";
+        delay(7);
+        EXPECT_TRUE(sensor.tryCollect(sample)) << "First measurement collected";
+        sensor.startSample();
+        EXPECT_FALSE(sensor.tryCollect(sample)) << "Conversion still running";
+        delay(7);
+        EXPECT_TRUE(sensor.tryCollect(sample)) << "Conversion done";
+        EXPECT_EQ(39, sample.x) << "X ok";
+        EXPECT_FALSE(sensor.tryCollect(sample)) << "Collected only once";
+    }
+
+    TEST(SensorSimulatorTest, hmcContinuousTest) {
+        setRealTime(false);
+        HmcSimulator simulator;
+        simulator.setField(-0.5, 0.25, 1);
+        MagnetoSensorHmc sensor(&simulator);
+        sensor.configureRate(HmcRate75, HmcContinuous);
+        sensor.begin();
+        // a bit more than a period at 75 Hz. Unlike advance(), delay() moves the driver's clock too.
+        constexpr unsigned long PeriodMillis = 14;
+        delay(PeriodMillis);
+        SensorData sample{};
+        EXPECT_TRUE(sensor.read(sample)) << "New sample available";
+        EXPECT_TRUE(sensor.hasOldGain()) << "The conversion that begin() started has the power-on gain";
+        delay(PeriodMillis);
+        EXPECT_TRUE(sensor.read(sample)) << "Next sample available";
+        EXPECT_FALSE(sensor.hasOldGain()) << "Configured gain";
+        EXPECT_EQ(-195, sample.x) << "X ok";
+        EXPECT_EQ(98, sample.y) << "Y ok";
+        EXPECT_EQ(390, sample.z) << "Z ok";
+        EXPECT_FALSE(sensor.read(sample)) << "No new sample yet";
+        const auto measurements = simulator.getMeasurements();
+        delay(PeriodMillis);
+        EXPECT_TRUE(sensor.read(sample)) << "Next sample available";
+        EXPECT_EQ(measurements + 1, simulator.getMeasurements()) << "One more measurement";
+    }
+
+    TEST(SensorSimulatorTest, hmcRangeSwitchTest) {
+        setRealTime(false);
+        HmcSimulator simulator;
+        simulator.setField(0.5, 0, 0);
+        MagnetoSensorHmc sensor(&simulator);
+        sensor.configureRange(HmcRange0_88);
+        sensor.begin();
+        SensorData samples[2]{};
+        EXPECT_EQ(2u, sensor.readBatch(samples, 2)) << "Skipped the sample with the power-on gain";
+        EXPECT_EQ(685, samples[1].x) << "0.88 Ga range";
+        SensorData sample{};
+
+        const auto start = micros();
+        EXPECT_TRUE(sensor.increaseRange()) << "Range increased";
+        EXPECT_GT(1000ul, micros() - start) << "Switching doesn't wait for a measurement";
+        EXPECT_EQ(1u, sensor.readBatch(&sample, 1)) << "First sample after the switch";
+        EXPECT_TRUE(sensor.hasOldGain()) << "First sample has the old gain";
+        EXPECT_EQ(685, sample.x) << "Old gain";
+        EXPECT_EQ(1u, sensor.readBatch(&sample, 1)) << "Second sample after the switch";
+        EXPECT_FALSE(sensor.hasOldGain()) << "Second sample has the new gain";
+        EXPECT_EQ(545, sample.x) << "New gain";
+    }
+
+    TEST(SensorSimulatorTest, hmcRangeSwitchTaggingTest) {
+        setRealTime(false);
+        HmcSimulator simulator;
+        simulator.setField(0.5, 0, 0);
+        MagnetoSensorHmc sensor(&simulator);
+        sensor.configureRange(HmcRange0_88);
+        sensor.configureRate(HmcRate75, HmcContinuous);
+        sensor.begin();
+        SampleRing<8> ring;
+        Sampler<8> sampler(&sensor, &ring);
+        // a bit more than a period at 75 Hz. Unlike advance(), delay() moves the driver's clock too.
+        constexpr unsigned long PeriodMillis = 14;
+        for (int i = 0; i < 2; i++) {
+            delay(PeriodMillis);
+            EXPECT_TRUE(sampler.sample()) << "Sample before the switch " << i;
+        }
+        EXPECT_TRUE(sensor.increaseRange()) << "Range increased";
+        for (int i = 0; i < 2; i++) {
+            delay(PeriodMillis);
+            EXPECT_TRUE(sampler.sample()) << "Sample after the switch " << i;
+        }
+        TimedSample samples[4];
+        EXPECT_EQ(4u, ring.drain(samples, 4)) << "Four samples";
+        EXPECT_EQ(SampleOldGain, samples[0].flags) << "Power-on gain";
+        EXPECT_EQ(0, samples[1].flags) << "Nothing special";
+        EXPECT_EQ(SampleGainChanged | SampleOldGain, samples[2].flags) << "Gain changed, but this sample has the old one";
+        EXPECT_EQ(685, samples[2].data.x) << "Old gain";
+        EXPECT_EQ(0, samples[3].flags) << "New gain applies";
+        EXPECT_EQ(545, samples[3].data.x) << "New gain";
+    }
+
+    TEST(SensorSimulatorTest, hmcRegisterShadowTest) {
+        setRealTime(false);
+        HmcSimulator simulator;
+        MagnetoSensorHmc sensor(&simulator);
+        sensor.begin();
+        sensor.configureOverSampling(HmcSampling4);
+        sensor.softReset();
+        unsigned long transactions = simulator.getTransactions();
+        EXPECT_TRUE(sensor.decreaseRange()) << "Switched to 4.0";
+        EXPECT_EQ(transactions + 1, simulator.getTransactions()) << "Only control B written";
+
+        // the sensor lost its configuration, and the shadow doesn't know
+        simulator.reset();
+        transactions = simulator.getTransactions();
+        sensor.softReset();
+        EXPECT_EQ(0x58, simulator.getRegister(HmcControlA)) << "Control A restored";
+        EXPECT_EQ(HmcRange4_0, simulator.getRegister(HmcControlB)) << "Control B restored";
+        // control A, B and mode in one transaction, then the pipelined read: mode, data pointer and data
+        EXPECT_EQ(transactions + 4, simulator.getTransactions()) << "Nothing skipped";
+
+        simulator.setConnected(false);
+        EXPECT_TRUE(sensor.decreaseRange()) << "Driver switched";
+        simulator.setConnected(true);
+        EXPECT_EQ(HmcRange4_0, simulator.getRegister(HmcControlB)) << "Sensor missed the switch";
+        transactions = simulator.getTransactions();
+        sensor.softReset();
+        EXPECT_EQ(HmcRange2_5, simulator.getRegister(HmcControlB)) << "Written again, as the sensor didn't acknowledge";
+        EXPECT_EQ(transactions + 4, simulator.getTransactions()) << "Control B and mode in one transaction";
+    }
+
+    TEST(SensorSimulatorTest, qmcRegisterShadowTest) {
+        setRealTime(false);
+        QmcSimulator simulator;
+        MagnetoSensorQmc sensor(&simulator);
+        sensor.begin();
+        unsigned long transactions = simulator.getTransactions();
+        EXPECT_TRUE(sensor.decreaseRange()) << "Switched to 2G";
+        EXPECT_EQ(0x09, simulator.getRegister(0x09)) << "Control 1 has the new range";
+        EXPECT_EQ(transactions + 1, simulator.getTransactions()) << "Set/reset period skipped";
+
+        transactions = simulator.getTransactions();
+        sensor.softReset();
+        EXPECT_EQ(transactions + 4, simulator.getTransactions()) << "Everything written after the reset";
+    }
+
+    TEST(SensorSimulatorTest, qmcReadTest) {
+        setRealTime(false);
+        QmcSimulator simulator;
+        simulator.setField(0.5, -1, 2);
+        MagnetoSensorQmc sensor(&simulator);
+        sensor.begin();
+        EXPECT_EQ(0x19, simulator.getRegister(0x09)) << "Configured continuous, 100 Hz, 8G, OSR 512";
+        EXPECT_EQ(0x40, simulator.getRegister(0x0a)) << "Pointer roll-over on, so reads can start at the status";
+        EXPECT_EQ(10000ul, simulator.getPeriod()) << "Period ok";
+        SensorData sample{};
+        EXPECT_FALSE(sensor.read(sample)) << "No sample yet";
+        simulator.advance(simulator.getPeriod());
+        EXPECT_TRUE(sensor.read(sample)) << "First sample";
+        EXPECT_EQ(1500, sample.x) << "X ok";
+        EXPECT_EQ(-3000, sample.y) << "Y ok";
+        EXPECT_EQ(6000, sample.z) << "Z ok";
+        EXPECT_FALSE(sensor.read(sample)) << "Sample already read";
+        EXPECT_EQ(1500, sample.x) << "Stale read leaves the sample alone";
+
+        simulator.advance(3 * simulator.getPeriod());
+        EXPECT_TRUE(sensor.read(sample)) << "Sample after a gap";
+        EXPECT_EQ(1u, sensor.getSkippedSamples()) << "Sensor reported skipping";
+
+        simulator.setField(9, 0, 0);
+        simulator.advance(simulator.getPeriod());
+        EXPECT_TRUE(sensor.read(sample)) << "Overflowing sample";
+        EXPECT_EQ(SHRT_MIN, sample.x) << "X marked saturated";
+        EXPECT_EQ(0, sample.y) << "Y not saturated";
+    }
+
+    TEST(SensorSimulatorTest, qmcReadBatchTest) {
+        setRealTime(false);
+        QmcSimulator simulator;
+        simulator.setField(0.1, 0.2, 0.3);
+        MagnetoSensorQmc sensor(&simulator);
+        sensor.begin();
+        constexpr size_t Count = 5;
+        SensorData samples[Count]{};
+        EXPECT_EQ(Count, sensor.readBatch(samples, Count)) << "Batch complete";
+        EXPECT_EQ(Count, simulator.getMeasurements()) << "Each measurement read once";
+        EXPECT_EQ(0u, sensor.getSkippedSamples()) << "Nothing skipped";
+        EXPECT_EQ(900, samples[Count - 1].z) << "Z ok";
+
+        simulator.setConnected(false);
+        EXPECT_EQ(0u, sensor.readBatch(samples, Count)) << "Nothing when disconnected";
+    }
+}
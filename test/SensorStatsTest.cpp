@@ -0,0 +1,112 @@
+// Copyright 2024 Rik Essenius
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+// except in compliance with the License. You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and limitations under the License.
+
+#include "gtest/gtest.h"
+#include <Wire.h>
+#include <MagnetoSensorHmc.h>
+#include <MagnetoSensorQmc.h>
+
+namespace MagnetoSensorsTest {
+    using namespace MagnetoSensors;
+
+    TEST(SensorStatsTest, latencyHistogramTest) {
+        LatencyHistogram histogram;
+        EXPECT_EQ(0u, histogram.getPercentile(50)) << "No data, no percentile";
+        histogram.add(0);
+        histogram.add(1);
+        histogram.add(3);
+        histogram.add(100);
+        histogram.add(1000000);
+        EXPECT_EQ(1u, histogram.getCount(0)) << "0 in bucket 0";
+        EXPECT_EQ(1u, histogram.getCount(1)) << "1 in bucket 1";
+        EXPECT_EQ(1u, histogram.getCount(2)) << "3 in bucket 2";
+        EXPECT_EQ(1u, histogram.getCount(7)) << "100 in bucket 7 [64, 128)";
+        EXPECT_EQ(1u, histogram.getCount(LatencyHistogram::BucketCount - 1)) << "Long one in the last bucket";
+        EXPECT_EQ(5u, histogram.getTotal()) << "Total";
+        EXPECT_EQ(4u, histogram.getPercentile(60)) << "60% below 4 us";
+        EXPECT_EQ(128u, histogram.getPercentile(80)) << "80% below 128 us";
+        histogram.reset();
+        EXPECT_EQ(0u, histogram.getTotal()) << "Reset";
+    }
+
+#ifdef MAGNETOSENSOR_STATS
+
+    TEST(SensorStatsTest, hmcStatsTest) {
+        EXPECT_TRUE(SensorStats::Enabled) << "Enabled";
+        MagnetoSensorHmc sensor(&Wire);
+        Wire.begin();
+        sensor.begin();
+        EXPECT_EQ(1u, sensor.getStats().getSoftResets()) << "begin does a soft reset";
+        sensor.resetStats();
+        EXPECT_EQ(0u, sensor.getStats().getReads()) << "Reset";
+
+        SensorData sample{};
+        Wire.setFlatline(true, 0x01);
+        EXPECT_TRUE(sensor.read(sample)) << "Read";
+        // 0xeeee is below the HMC saturation value
+        Wire.setFlatline(true, 0xee);
+        EXPECT_TRUE(sensor.read(sample)) << "Read saturated";
+        Wire.setFlatline(false, 0);
+        const auto& stats = sensor.getStats();
+        EXPECT_EQ(2u, stats.getReads()) << "Two reads";
+        EXPECT_EQ(0u, stats.getFailures()) << "No failures";
+        EXPECT_EQ(1u, stats.getSaturations()) << "One saturated";
+        EXPECT_EQ(2u, stats.getLatency().getTotal()) << "Two latencies";
+
+        EXPECT_TRUE(sensor.increaseRange()) << "Range increased";
+        EXPECT_EQ(1u, stats.getRangeIncreases()) << "Range increase counted";
+        EXPECT_EQ(0u, stats.getSoftResets()) << "Increasing the range doesn't reset";
+        EXPECT_TRUE(sensor.decreaseRange()) << "Range decreased";
+        EXPECT_EQ(1u, stats.getRangeDecreases()) << "Range decrease counted";
+
+        Wire.setEndTransmissionTogglePeriod(1);
+        sensor.read(sample);
+        sensor.read(sample);
+        Wire.setEndTransmissionTogglePeriod(0);
+        unsigned long errors = 0;
+        for (byte code = 1; code < SensorStats::ErrorCodeCount; code++) {
+            errors += stats.getTransmissionErrors(code);
+        }
+        EXPECT_LT(0u, errors) << "Transmission errors counted";
+        EXPECT_EQ(0u, stats.getTransmissionErrors(0)) << "Success is not an error";
+    }
+
+    TEST(SensorStatsTest, qmcStatsTest) {
+        MagnetoSensorQmc sensor(&Wire);
+        Wire.begin();
+        sensor.begin();
+        SensorData sample{};
+        // no data ready
+        Wire.setFlatline(true, 0x00);
+        EXPECT_FALSE(sensor.read(sample)) << "Nothing new";
+        Wire.setFlatline(true, 0x01);
+        EXPECT_TRUE(sensor.read(sample)) << "New sample";
+        Wire.setFlatline(false, 0);
+        EXPECT_EQ(2u, sensor.getStats().getReads()) << "Two reads";
+        EXPECT_EQ(1u, sensor.getStats().getStale()) << "One without new data";
+        EXPECT_EQ(0u, sensor.getStats().getFailures()) << "No failures";
+    }
+
+#else
+
+    TEST(SensorStatsTest, statsDisabledTest) {
+        EXPECT_FALSE(SensorStats::Enabled) << "Disabled";
+        MagnetoSensorQmc sensor(&Wire);
+        Wire.begin();
+        sensor.begin();
+        SensorData sample{};
+        sensor.read(sample);
+        EXPECT_EQ(0u, sensor.getStats().getReads()) << "Nothing counted";
+        EXPECT_EQ(0u, sensor.getStats().getLatency().getTotal()) << "No latencies";
+    }
+
+#endif
+}
@@ -0,0 +1,116 @@
+// Copyright 2024 Rik Essenius
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+// except in compliance with the License. You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and limitations under the License.
+
+#include "gtest/gtest.h"
+#include <climits>
+#include <HmcSensor.h>
+#include <MagnetoSensorAdapter.h>
+#include <QmcSensor.h>
+#include "HmcSimulator.h"
+#include "QmcSimulator.h"
+
+namespace MagnetoSensorsTest {
+    using namespace MagnetoSensors;
+
+    using Qmc2G200 = QmcSensor<QmcRange2G, QmcRate200Hz, QmcSampling128>;
+    using Hmc8Continuous = HmcSensor<HmcRange8_1, HmcRate30, HmcSampling4, HmcContinuous>;
+
+    // these are all known at compile time
+    static_assert(Qmc2G200::Control1 == 0b10001101, "QMC control 1");
+    static_assert(Qmc2G200::Gain == 12000.0, "QMC 2G gain");
+    static_assert(QmcSensor<>::Control1 == 0x19, "QMC default configuration, as MagnetoSensorQmc");
+    static_assert(QmcSensor<>::Gain == 3000.0, "QMC 8G gain");
+    static_assert(Hmc8Continuous::ControlA == 0b01010100, "HMC control A");
+    static_assert(Hmc8Continuous::ControlB == 0b11100000, "HMC control B");
+    static_assert(Hmc8Continuous::Gain == 230.0, "HMC 8.1 gain");
+    static_assert(HmcSensor<>::ControlA == 0x78, "HMC default configuration, as MagnetoSensorHmc");
+    static_assert(HmcSensor<HmcRange1_3>::NoiseRange == 5, "HMC 1.3 noise range");
+
+    TEST(SensorTemplateTest, qmcSensorTest) {
+        setRealTime(false);
+        QmcSimulator simulator;
+        simulator.setField(0.5, -0.25, 3);
+        Qmc2G200 sensor(&simulator);
+        EXPECT_TRUE(sensor.begin()) << "Started";
+        EXPECT_EQ(Qmc2G200::Control1, simulator.getRegister(QmcControl1)) << "Control 1 written";
+        EXPECT_EQ(5000ul, simulator.getPeriod()) << "200 Hz";
+        SensorData sample{};
+        EXPECT_FALSE(sensor.read(sample)) << "No sample yet";
+        simulator.advance(simulator.getPeriod());
+        EXPECT_TRUE(sensor.read(sample)) << "Got a sample";
+        EXPECT_EQ(6000, sample.x) << "X ok";
+        EXPECT_EQ(-3000, sample.y) << "Y ok";
+        EXPECT_EQ(SHRT_MIN, sample.z) << "Z out of range";
+        simulator.advance(2 * simulator.getPeriod());
+        EXPECT_TRUE(sensor.read(sample)) << "Got the next sample";
+        EXPECT_EQ(1u, sensor.getSkippedSamples()) << "Skipped one";
+    }
+
+    TEST(SensorTemplateTest, hmcSensorTest) {
+        setRealTime(false);
+        HmcSimulator simulator;
+        simulator.setField(1, -2, 4);
+        Hmc8Continuous sensor(&simulator);
+        EXPECT_TRUE(sensor.begin()) << "Started";
+        EXPECT_EQ(Hmc8Continuous::ControlA, simulator.getRegister(HmcControlA)) << "Control A written";
+        EXPECT_EQ(Hmc8Continuous::ControlB, simulator.getRegister(HmcControlB)) << "Control B written";
+        SensorData sample{};
+        EXPECT_FALSE(sensor.read(sample)) << "No sample yet";
+        simulator.advance(1000000 / 30 + 1);
+        EXPECT_TRUE(sensor.read(sample)) << "Got a sample";
+        EXPECT_EQ(1090, sample.x) << "The first sample still has the power-on gain";
+        simulator.advance(1000000 / 30 + 1);
+        EXPECT_TRUE(sensor.read(sample)) << "Got the next sample";
+        EXPECT_EQ(230, sample.x) << "X ok";
+        EXPECT_EQ(-460, sample.y) << "Y ok";
+        EXPECT_EQ(920, sample.z) << "Z ok";
+        EXPECT_FALSE(sensor.read(sample)) << "No new sample";
+    }
+
+    TEST(SensorTemplateTest, adapterTest) {
+        setRealTime(false);
+        QmcSimulator simulator;
+        simulator.setField(0.1, 0.2, 0.3);
+        MagnetoSensorAdapter<QmcSensor<>> adapter(&simulator);
+        MagnetoSensor* sensor = &adapter;
+        EXPECT_TRUE(sensor->begin()) << "Started";
+        EXPECT_EQ(3000.0, sensor->getGain()) << "Gain";
+        EXPECT_EQ(60, sensor->getNoiseRange()) << "Noise range";
+        EXPECT_TRUE(sensor->isOn()) << "Sensor is on";
+        SensorData samples[3]{};
+        EXPECT_EQ(3u, sensor->readBatch(samples, 3)) << "Batch waits for the samples";
+        EXPECT_EQ(900, samples[2].z) << "Z ok";
+        EXPECT_EQ(0u, adapter.getSensor().getSkippedSamples()) << "Nothing skipped";
+    }
+
+    TEST(SensorTemplateTest, adapterHmcSingleTest) {
+        setRealTime(false);
+        HmcSimulator simulator;
+        simulator.setField(0.1, 0.2, 0.3);
+        MagnetoSensorAdapter<HmcSensor<>> adapter(&simulator);
+        MagnetoSensor* sensor = &adapter;
+        EXPECT_TRUE(sensor->begin()) << "Started";
+        SensorData samples[3]{};
+        const unsigned long batchStart = simulator.now();
+        const auto measurements = simulator.getMeasurements();
+        EXPECT_EQ(3u, sensor->readBatch(samples, 3)) << "Batch waits for the samples";
+        // read() in single mode would have returned the previous measurement right away
+        EXPECT_LE(3 * HmcSimulator::SingleMeasurementMicros, simulator.now() - batchStart) << "Each measurement awaited";
+        EXPECT_EQ(measurements + 3, simulator.getMeasurements()) << "One measurement per sample";
+        EXPECT_EQ(39, samples[2].x) << "X ok";
+        EXPECT_EQ(117, samples[2].z) << "Z ok";
+
+        simulator.setConnected(false);
+        const unsigned long start = micros();
+        EXPECT_EQ(0u, sensor->readBatch(samples, 1)) << "Nothing when disconnected";
+        EXPECT_GT(2 * HmcSensor<>::ReadyTimeoutMicros, micros() - start) << "Gave up after the timeout";
+    }
+}
@@ -0,0 +1,183 @@
+// Copyright 2024 Rik Essenius
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+// except in compliance with the License. You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and limitations under the License.
+
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <MagnetoSensorQmc.h>
+#include <SensorWatchdog.h>
+#include "QmcSimulator.h"
+
+namespace MagnetoSensorsTest {
+    using namespace MagnetoSensors;
+
+    namespace {
+        constexpr byte PowerPin = 15;
+
+        // a QMC that gets its power from PowerPin, and that can hang until it is power cycled
+        class PoweredQmc final : public QmcSimulator {
+        public:
+            void beginTransmission(const uint8_t address) override {
+                applyPower();
+                QmcSimulator::beginTransmission(address);
+            }
+
+            void hang() { _isHung = true; }
+
+            uint8_t requestFrom(const uint8_t address, const size_t size, const bool sendStop = true) override {
+                applyPower();
+                return QmcSimulator::requestFrom(address, size, sendStop);
+            }
+
+        private:
+            void applyPower() {
+                const bool isPowered = digitalRead(PowerPin) == HIGH;
+                if (!isPowered) _isHung = false;
+                setConnected(isPowered && !_isHung);
+            }
+
+            bool _isHung = false;
+        };
+
+        // returns the same sample forever
+        class FrozenSensor final : public MagnetoSensor {
+        public:
+            explicit FrozenSensor(TwoWire* wire) : MagnetoSensor(0, wire) {}
+            bool begin() override {
+                _begins++;
+                return true;
+            }
+            double getGain() const override { return 1.0; }
+            int getNoiseRange() const override { return 1; }
+            int getBegins() const { return _begins; }
+            bool isOn() override { return _isOn; }
+            bool read(SensorData& sample) override {
+                sample = _sample;
+                return true;
+            }
+            void setOn(const bool isOn) { _isOn = isOn; }
+            void softReset() override {}
+        private:
+            SensorData _sample { 1, 2, 3 };
+            bool _isOn = true;
+            int _begins = 0;
+        };
+    }
+
+    TEST(SensorWatchdogTest, sensorWatchdogPowerCycleTest) {
+        setRealTime(false);
+        PoweredQmc bus;
+        bus.setField(0.1, 0.2, 0.3);
+        bus.setNoise(3);
+        MagnetoSensorQmc sensor(&bus);
+        SensorWatchdog watchdog(&sensor, PowerPin);
+        watchdog.begin();
+        EXPECT_EQ(HIGH, digitalRead(PowerPin)) << "Powered";
+        EXPECT_TRUE(sensor.begin()) << "Sensor started";
+
+        SensorData sample{};
+        unsigned long good = 0;
+        for (int i = 0; i < 100; i++) {
+            const bool success = sensor.read(sample);
+            if (success) good++;
+            EXPECT_TRUE(watchdog.check(success, sample)) << "Healthy " << i;
+            delay(10);
+        }
+        EXPECT_LT(50u, good) << "Samples coming in";
+
+        bus.hang();
+        const unsigned long hangStart = micros();
+        while (watchdog.check(sensor.read(sample), sample)) delay(10);
+        // the timeout runs from the last good sample, which can be up to a loop before the hang
+        EXPECT_NEAR(SensorWatchdog::DefaultTimeoutMicros, micros() - hangStart, 20000) << "Detected after the timeout";
+        EXPECT_EQ(FaultTimeout, watchdog.getLastFault()) << "No data";
+        EXPECT_EQ(WatchdogPoweringOff, watchdog.getState()) << "Powering off";
+        EXPECT_EQ(LOW, digitalRead(PowerPin)) << "Power pin down";
+
+        // nothing in the recovery waits
+        int steps = 0;
+        unsigned long longestStep = 0;
+        while (!watchdog.update()) {
+            const unsigned long start = micros();
+            EXPECT_FALSE(watchdog.check(false, sample)) << "Not healthy while recovering";
+            longestStep = std::max(longestStep, micros() - start);
+            steps++;
+            ASSERT_GT(1000, steps) << "Recovery ends";
+            delay(1);
+        }
+        EXPECT_GT(100u, longestStep) << "Steps don't wait";
+        EXPECT_EQ(HIGH, digitalRead(PowerPin)) << "Powered again";
+        EXPECT_EQ(1u, watchdog.getRecoveries()) << "One recovery";
+        EXPECT_EQ(0u, watchdog.getFailedAttempts()) << "First attempt worked";
+        EXPECT_LE(SensorWatchdog::DefaultSettleMicros, watchdog.getLastRecoveryMicros()) << "Power was off long enough";
+        EXPECT_GT(SensorWatchdog::DefaultSettleMicros + 5000, watchdog.getLastRecoveryMicros()) << "No time wasted";
+        EXPECT_EQ(watchdog.getLastRecoveryMicros(), watchdog.getTotalRecoveryMicros()) << "Total";
+
+        delay(10);
+        EXPECT_TRUE(sensor.read(sample)) << "Reads again";
+        EXPECT_TRUE(watchdog.check(true, sample)) << "Healthy again";
+    }
+
+    TEST(SensorWatchdogTest, sensorWatchdogStuckTest) {
+        setRealTime(false);
+        QmcSimulator bus;
+        FrozenSensor sensor(&bus);
+        SensorWatchdog watchdog(&sensor);
+        watchdog.configureLimits(0, 3, 2);
+        watchdog.begin();
+        SensorData sample{};
+        for (int i = 0; i < 4; i++) {
+            sensor.read(sample);
+            EXPECT_TRUE(watchdog.check(true, sample)) << "Repeats allowed " << i;
+        }
+        sensor.read(sample);
+        EXPECT_FALSE(watchdog.check(true, sample)) << "One repeat too many";
+        EXPECT_EQ(FaultRepeated, watchdog.getLastFault()) << "Same sample";
+        EXPECT_EQ(WatchdogPoweringOn, watchdog.getState()) << "No power pin, so restart right away";
+        EXPECT_TRUE(watchdog.update()) << "Restarted";
+        EXPECT_EQ(1, sensor.getBegins()) << "begin() called";
+
+        // saturation counts even if the samples differ
+        for (short i = 0; i < 3; i++) {
+            sample = { SHRT_MIN, i, 0 };
+            EXPECT_EQ(i < 2, watchdog.check(true, sample)) << "Saturated " << i;
+        }
+        EXPECT_EQ(FaultSaturated, watchdog.getLastFault()) << "Saturated";
+
+        // a sensor that doesn't come back gets retried after the deadline
+        sensor.setOn(false);
+        const unsigned long start = micros();
+        while (watchdog.getFailedAttempts() < 2) {
+            EXPECT_FALSE(watchdog.update()) << "Not back";
+            delay(1);
+        }
+        EXPECT_LE(2 * SensorWatchdog::DefaultPowerOnTimeoutMicros, micros() - start) << "Waited for the deadlines";
+        sensor.setOn(true);
+        EXPECT_TRUE(watchdog.update()) << "Back";
+        EXPECT_EQ(2u, watchdog.getRecoveries()) << "Two recoveries";
+        EXPECT_LT(watchdog.getLastRecoveryMicros(), watchdog.getTotalRecoveryMicros()) << "Total includes the first";
+
+        watchdog.recover();
+        EXPECT_EQ(FaultNone, watchdog.getLastFault()) << "Requested";
+        EXPECT_TRUE(watchdog.update()) << "Restarted on request";
+        EXPECT_EQ(3, sensor.getBegins()) << "begin() for each recovery";
+    }
+
+    TEST(SensorWatchdogTest, sensorWatchdogWaitForPowerOffTest) {
+        setRealTime(false);
+        QmcSimulator bus;
+        MagnetoSensorQmc sensor(&bus);
+        const unsigned long start = micros();
+        EXPECT_FALSE(sensor.waitForPowerOff(1000)) << "Still on after the timeout";
+        EXPECT_GT(2000u, micros() - start) << "Gave up in time";
+        bus.setConnected(false);
+        EXPECT_TRUE(sensor.waitForPowerOff()) << "Off";
+    }
+}
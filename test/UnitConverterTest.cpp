@@ -0,0 +1,71 @@
+// Copyright 2024 Rik Essenius
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+// except in compliance with the License. You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software distributed under the License
+// is distributed on an "AS IS" BASIS WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and limitations under the License.
+
+#include "gtest/gtest.h"
+#include <climits>
+#include <cmath>
+#include <UnitConverter.h>
+
+namespace MagnetoSensorsTest {
+    using namespace MagnetoSensors;
+
+    namespace {
+        constexpr size_t Count = 4;
+        const SensorData Samples[Count] = { {0, 1, -1}, {100, -100, 2047}, {SHRT_MAX, -SHRT_MAX, 12345}, {-2048, 7, -7} };
+
+        void expectAccurate(const UnitConverter& converter, const double gain, const char* range) {
+            int32_t fixed[3 * Count];
+            float microTesla[3 * Count];
+            float nanoTesla[3 * Count];
+            converter.toNanoTesla(Samples, fixed, Count);
+            converter.toMicroTesla(Samples, microTesla, Count);
+            converter.toNanoTesla(Samples, nanoTesla, Count);
+            const short* raw = &Samples[0].x;
+            for (size_t i = 0; i < 3 * Count; i++) {
+                const double expected = raw[i] * 100000.0 / gain;
+                // Q format error over the full range, plus rounding down
+                EXPECT_NEAR(expected, fixed[i], 1.0 + std::abs(expected) / 30000.0) << range << " fixed nT " << i;
+                EXPECT_NEAR(expected / 1000.0, microTesla[i], std::abs(expected) / 1e9 + 1e-6) << range << " float uT " << i;
+                EXPECT_NEAR(expected, nanoTesla[i], std::abs(expected) / 1e6 + 1e-3) << range << " float nT " << i;
+            }
+        }
+    }
+
+    TEST(UnitConverterTest, hmcRangesTest) {
+        const HmcRange ranges[] = { HmcRange0_88, HmcRange1_3, HmcRange1_9, HmcRange2_5, HmcRange4_0, HmcRange4_7, HmcRange5_6, HmcRange8_1 };
+        for (const auto range : ranges) {
+            const auto& converter = UnitConverter::get(range);
+            const double gain = MagnetoSensorHmc::getGain(range);
+            EXPECT_LT(converter.getFixedScale().factor, 32768) << "Factor fits 15 bits";
+            EXPECT_GE(converter.getFixedScale().factor, 16384) << "Factor uses all 15 bits";
+            expectAccurate(converter, gain, "HMC");
+        }
+    }
+
+    TEST(UnitConverterTest, qmcRangesTest) {
+        expectAccurate(UnitConverter::get(QmcRange2G), MagnetoSensorQmc::getGain(QmcRange2G), "QMC 2G");
+        expectAccurate(UnitConverter::get(QmcRange8G), MagnetoSensorQmc::getGain(QmcRange8G), "QMC 8G");
+        EXPECT_FLOAT_EQ(1.0f / 30.0f, UnitConverter::get(QmcRange8G).getMicroTeslaPerCount()) << "8G: divide by 30 for uT";
+    }
+
+    TEST(UnitConverterTest, gainTest) {
+        const UnitConverter converter(390.0);
+        const auto expected = UnitConverter::get(HmcRange4_7).getFixedScale();
+        EXPECT_EQ(expected.factor, converter.getFixedScale().factor) << "Same factor as the table";
+        EXPECT_EQ(expected.shift, converter.getFixedScale().shift) << "Same shift as the table";
+        expectAccurate(UnitConverter(1234.5), 1234.5, "Arbitrary gain");
+
+        const UnitConverter none(0.0);
+        int32_t fixed[3 * Count];
+        none.toNanoTesla(Samples, fixed, Count);
+        EXPECT_EQ(0, fixed[5]) << "No gain converts to 0";
+    }
+}